@@ -0,0 +1,69 @@
+#include <stdint.h>
+#include <math.h>
+#include <iostream>
+#include <memory>
+#include <iomanip>
+#include <vector>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <algorithm>
+#include <assert.h>
+#include <chrono>
+#include <histogram.h>
+
+// Compares recording a buffer of timings one value at a time with the
+// batched recordValues path.  Reports values recorded per second.
+
+const int64_t HIGHEST_TRACKABLE_VALUE = 3600000000;
+const int64_t SIGNIFICANT_DIGITS = 3;
+const size_t VALUE_COUNT = 1 << 20;
+const int ITERATIONS = 50;
+
+static std::vector<int64_t> latencies()
+{
+    // Mostly fast requests with a long tail, like a real latency trace.
+    std::vector<int64_t> values;
+    uint64_t seed = 42;
+    for (size_t i = 0; i < VALUE_COUNT; i++)
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        auto magnitude = (seed >> 60) < 14 ? 16 : 30;
+        values.push_back((int64_t) ((seed >> 20) & ((1ULL << magnitude) - 1)));
+    }
+    return values;
+}
+
+static void report(const char* name, std::chrono::steady_clock::duration elapsed)
+{
+    auto seconds = std::chrono::duration<double>(elapsed).count();
+    std::cout << std::setw(28) << std::left << name
+              << std::setw(14) << std::right << std::fixed << std::setprecision(0)
+              << (VALUE_COUNT * (double) ITERATIONS) / seconds << " values/s" << std::endl;
+}
+
+int main()
+{
+    auto values = latencies();
+
+    Histogram single{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        for (auto value : values)
+        {
+            single.recordValue(value);
+        }
+    }
+    report("recordValue loop", std::chrono::steady_clock::now() - start);
+
+    Histogram batched{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        batched.recordValues(values.data(), values.size());
+    }
+    report("recordValues", std::chrono::steady_clock::now() - start);
+
+    return single.getTotalCount() == batched.getTotalCount() ? 0 : 1;
+}
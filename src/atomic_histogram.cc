@@ -0,0 +1,36 @@
+#include <stdint.h>
+#include <math.h>
+#include <assert.h>
+
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
+#include "histogram.h"
+#include "atomic_histogram.h"
+
+// The shard of a StripedHistogram has one writer, so its counts can be bumped
+// without the lock prefix; readers still see whole values.
+template <>
+void BasicHistogram< AtomicCount >::recordValueSingleWriter(int64_t value)
+{
+    auto countsIndex = countsIndexForRecording(value);
+
+    counts.addSingleWriter(countsIndex, 1);
+    markOccupied(countsIndex);
+    totalCount.addSingleWriter(1);
+
+    if (trackStatistics)
+    {
+        updateStatistics(countsIndex, 1);
+    }
+    if (!rankIndex.empty())
+    {
+        addToRankIndex(countsIndex, 1);
+    }
+}
@@ -0,0 +1,178 @@
+// Required includes
+// #include <stdint.h>
+// #include <math.h>
+// #include <atomic>
+// #include <iostream>
+// #include <memory>
+// #include <vector>
+// #include <limits>
+// #include <algorithm>
+// #include <functional>
+// #include <iterator>
+// #include <assert.h>
+// #include "histogram.h"
+
+// Tag for histograms that any number of threads may record into at once.  The
+// counts are atomics updated with relaxed fetch_add, so recordValue needs no
+// lock.  Queries can run alongside writers, but only see a consistent view
+// once the writers have quiesced.  Auto-resize and rank indexing are not
+// thread safe; statistics tracking starts out off for the same reason.
+struct AtomicCount
+{
+};
+
+template <>
+class CountsArray< AtomicCount > final
+{
+
+public:
+
+    CountsArray() : counts{}, length{ 0 }
+    {
+    }
+
+    CountsArray(const CountsArray& other) : counts{}, length{ 0 }
+    {
+        *this = other;
+    }
+
+    CountsArray(CountsArray&& other) = default;
+    CountsArray& operator=(CountsArray&& other) = default;
+
+    CountsArray& operator=(const CountsArray& other)
+    {
+        if (this != &other)
+        {
+            counts.reset(new std::atomic< int64_t >[other.length]);
+            length = other.length;
+            for (int32_t i = 0; i < length; i++)
+            {
+                counts[i].store(other.get(i), std::memory_order_relaxed);
+            }
+        }
+        return *this;
+    }
+
+    int64_t get(int32_t index) const
+    {
+        return counts[index].load(std::memory_order_relaxed);
+    }
+
+    // Nothing is published through the counts, so relaxed ordering is enough;
+    // readers only need each increment to be applied exactly once.
+    void add(int32_t index, int64_t count)
+    {
+        counts[index].fetch_add(count, std::memory_order_relaxed);
+    }
+
+    void addSingleWriter(int32_t index, int64_t count)
+    {
+        counts[index].store(get(index) + count, std::memory_order_relaxed);
+    }
+
+    void resize(int32_t newLength)
+    {
+        std::unique_ptr< std::atomic< int64_t >[] > resized{ new std::atomic< int64_t >[newLength] };
+        for (int32_t i = 0; i < newLength; i++)
+        {
+            resized[i].store((i < length) ? get(i) : 0, std::memory_order_relaxed);
+        }
+        counts = std::move(resized);
+        length = newLength;
+    }
+
+    void clear()
+    {
+        clear(0, length);
+    }
+
+    void clear(int32_t fromIndex, int32_t toIndex)
+    {
+        for (int32_t i = fromIndex; i < toIndex; i++)
+        {
+            counts[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    int32_t size() const
+    {
+        return length;
+    }
+
+    int32_t wordSize() const
+    {
+        return sizeof(int64_t);
+    }
+
+    size_t footprintInBytes() const
+    {
+        return length * sizeof(std::atomic< int64_t >);
+    }
+
+private:
+    std::unique_ptr< std::atomic< int64_t >[] > counts;
+    int32_t length;
+
+};
+
+// Every writer bumps the total count, so it is kept on a cache line of its
+// own, away from the read-mostly fields of the histogram around it.
+class AtomicTotalCount final
+{
+
+public:
+
+    explicit AtomicTotalCount(int64_t count) : count{ count }
+    {
+    }
+
+    AtomicTotalCount(const AtomicTotalCount& other) : count{ (int64_t) other }
+    {
+    }
+
+    AtomicTotalCount& operator=(const AtomicTotalCount& other)
+    {
+        return *this = (int64_t) other;
+    }
+
+    AtomicTotalCount& operator=(int64_t count)
+    {
+        this->count.store(count, std::memory_order_relaxed);
+        return *this;
+    }
+
+    AtomicTotalCount& operator+=(int64_t count)
+    {
+        this->count.fetch_add(count, std::memory_order_relaxed);
+        return *this;
+    }
+
+    void addSingleWriter(int64_t count)
+    {
+        this->count.store((int64_t) *this + count, std::memory_order_relaxed);
+    }
+
+    operator int64_t() const
+    {
+        return count.load(std::memory_order_relaxed);
+    }
+
+private:
+    char padBefore[64];
+    std::atomic< int64_t > count;
+    char padAfter[64 - sizeof(std::atomic< int64_t >)];
+
+};
+
+template <>
+struct CountsTraits< AtomicCount >
+{
+    typedef AtomicTotalCount TotalCount;
+    static const bool tracksStatistics = false;
+    static const bool recordsConcurrently = true;
+};
+
+template <>
+void BasicHistogram< AtomicCount >::recordValueSingleWriter(int64_t value);
+
+typedef BasicHistogram< AtomicCount > AtomicHistogram;
@@ -0,0 +1,104 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#include "base64.h"
+
+static const char BASE64_ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static const int8_t INVALID_BASE64 = -1;
+
+struct Base64DecodeTable
+{
+    int8_t values[256];
+
+    Base64DecodeTable()
+    {
+        for (int i = 0; i < 256; i++)
+        {
+            values[i] = INVALID_BASE64;
+        }
+        for (int i = 0; i < 64; i++)
+        {
+            values[(uint8_t) BASE64_ALPHABET[i]] = (int8_t) i;
+        }
+    }
+};
+
+static const Base64DecodeTable decodeTable;
+
+size_t base64EncodedLength(size_t length)
+{
+    return ((length + 2) / 3) * 4;
+}
+
+size_t base64Encode(const uint8_t* bytes, size_t length, char* encoded)
+{
+    char* out = encoded;
+    size_t i = 0;
+    for (; i + 3 <= length; i += 3)
+    {
+        uint32_t triple = (bytes[i] << 16) | (bytes[i + 1] << 8) | bytes[i + 2];
+        *out++ = BASE64_ALPHABET[(triple >> 18) & 0x3f];
+        *out++ = BASE64_ALPHABET[(triple >> 12) & 0x3f];
+        *out++ = BASE64_ALPHABET[(triple >> 6) & 0x3f];
+        *out++ = BASE64_ALPHABET[triple & 0x3f];
+    }
+
+    if (i < length)
+    {
+        uint32_t triple = bytes[i] << 16;
+        if (i + 1 < length)
+        {
+            triple |= bytes[i + 1] << 8;
+        }
+        *out++ = BASE64_ALPHABET[(triple >> 18) & 0x3f];
+        *out++ = BASE64_ALPHABET[(triple >> 12) & 0x3f];
+        *out++ = (i + 1 < length) ? BASE64_ALPHABET[(triple >> 6) & 0x3f] : '=';
+        *out++ = '=';
+    }
+    return out - encoded;
+}
+
+size_t base64DecodedLength(size_t encodedLength)
+{
+    return (encodedLength / 4) * 3;
+}
+
+bool base64Decode(const char* encoded, size_t encodedLength, uint8_t* decoded, size_t& decodedLength)
+{
+    decodedLength = 0;
+    if (0 != encodedLength % 4)
+    {
+        return false;
+    }
+
+    uint8_t* out = decoded;
+    for (size_t i = 0; i < encodedLength; i += 4)
+    {
+        bool last = (i + 4 == encodedLength);
+        int32_t padding = (last && '=' == encoded[i + 3]) ? ((last && '=' == encoded[i + 2]) ? 2 : 1) : 0;
+
+        uint32_t quad = 0;
+        for (int32_t j = 0; j < 4 - padding; j++)
+        {
+            auto value = decodeTable.values[(uint8_t) encoded[i + j]];
+            if (INVALID_BASE64 == value)
+            {
+                return false;
+            }
+            quad |= ((uint32_t) value) << (18 - 6 * j);
+        }
+
+        *out++ = (uint8_t) (quad >> 16);
+        if (padding < 2)
+        {
+            *out++ = (uint8_t) (quad >> 8);
+        }
+        if (padding < 1)
+        {
+            *out++ = (uint8_t) quad;
+        }
+    }
+    decodedLength = out - decoded;
+    return true;
+}
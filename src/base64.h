@@ -0,0 +1,14 @@
+
+// Required includes
+// #include <stdint.h>
+// #include <stddef.h>
+
+// Standard (RFC 4648) base64 with padding, as used for the compressed
+// histograms in .hlog files.  Both directions work on caller owned buffers.
+size_t base64EncodedLength(size_t length);
+size_t base64Encode(const uint8_t* bytes, size_t length, char* encoded);
+
+// Returns false if encoded is not well formed base64; otherwise decoded
+// holds decodedLength bytes, at most base64DecodedLength(encodedLength).
+size_t base64DecodedLength(size_t encodedLength);
+bool base64Decode(const char* encoded, size_t encodedLength, uint8_t* decoded, size_t& decodedLength);
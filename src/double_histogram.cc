@@ -0,0 +1,257 @@
+#include <stdint.h>
+#include <math.h>
+#include <assert.h>
+
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
+#include "histogram.h"
+#include "double_histogram.h"
+
+// The integer histogram keeps numberOfSignificantValueDigits of precision for
+// every value from its sub-bucket half count upwards, so that is the smallest
+// integer a non-zero double value is ever scaled to.
+static int64_t lowestIntegerWithFullPrecision(int64_t numberOfSignificantValueDigits)
+{
+    auto largestValueWithSingleUnitResolution = 2 * pow(10, numberOfSignificantValueDigits);
+    auto subBucketCountMagnitude = (int32_t) ceil(log(largestValueWithSingleUnitResolution)/log(2));
+    auto subBucketHalfCountMagnitude = ((subBucketCountMagnitude > 1) ? subBucketCountMagnitude : 1) - 1;
+
+    return ((int64_t) 1) << subBucketHalfCountMagnitude;
+}
+
+// A value is scaled to somewhere in [lowest, 2 * lowest), so one more doubling
+// on top of the ratio keeps highestToLowestValueRatio of room above it.
+static int64_t highestTrackingIntegerValueFor(int64_t highestToLowestValueRatio,
+                                              int64_t numberOfSignificantValueDigits)
+{
+    auto ratioMagnitude = (int32_t) ceil(log(highestToLowestValueRatio)/log(2));
+    return lowestIntegerWithFullPrecision(numberOfSignificantValueDigits) << (ratioMagnitude + 1);
+}
+
+DoubleHistogram::DoubleHistogram(int64_t highestToLowestValueRatio,
+                                 int64_t numberOfSignificantValueDigits) :
+    highestToLowestValueRatio{ highestToLowestValueRatio },
+    numberOfSignificantValueDigits{ numberOfSignificantValueDigits },
+    lowestTrackingIntegerValue{ lowestIntegerWithFullPrecision(numberOfSignificantValueDigits) },
+    highestTrackingIntegerValue{ highestTrackingIntegerValueFor(highestToLowestValueRatio, numberOfSignificantValueDigits) },
+    doubleToIntegerValueConversionRatio{ 1.0 },
+    integerToDoubleValueConversionRatio{ 1.0 },
+    minNonZeroValue{ 0.0 },
+    maxValue{ 0.0 },
+    integerValuesHistogram{ highestTrackingIntegerValue, numberOfSignificantValueDigits }
+{
+    assert(highestToLowestValueRatio >= 2);
+    assert(highestTrackingIntegerValue > 0 && highestTrackingIntegerValue < (std::numeric_limits< int64_t >::max() >> 1));
+}
+
+DoubleHistogram::~DoubleHistogram()
+{
+}
+
+/////////////////// Properties /////////////////////
+
+int64_t DoubleHistogram::getHighestToLowestValueRatio() const
+{
+    return highestToLowestValueRatio;
+}
+
+int64_t DoubleHistogram::getNumberOfSignificantValueDigits() const
+{
+    return numberOfSignificantValueDigits;
+}
+
+int64_t DoubleHistogram::getTotalCount() const
+{
+    return integerValuesHistogram.getTotalCount();
+}
+
+int64_t DoubleHistogram::getCountAtValue(double value) const
+{
+    return integerValuesHistogram.getCountAtValue(integerValueFor(value));
+}
+
+double DoubleHistogram::getCurrentLowestTrackableNonZeroValue() const
+{
+    return lowestTrackingIntegerValue * integerToDoubleValueConversionRatio;
+}
+
+double DoubleHistogram::getCurrentHighestTrackableValue() const
+{
+    return highestTrackingIntegerValue * integerToDoubleValueConversionRatio;
+}
+
+/////////////////// Queries /////////////////////
+
+double DoubleHistogram::getMaxValue() const
+{
+    return integerValuesHistogram.getMaxValue() * integerToDoubleValueConversionRatio;
+}
+
+double DoubleHistogram::getMinValue() const
+{
+    return integerValuesHistogram.getMinValue() * integerToDoubleValueConversionRatio;
+}
+
+double DoubleHistogram::getMeanValue() const
+{
+    return integerValuesHistogram.getMeanValue() * integerToDoubleValueConversionRatio;
+}
+
+double DoubleHistogram::getStdDeviation() const
+{
+    return integerValuesHistogram.getStdDeviation() * integerToDoubleValueConversionRatio;
+}
+
+double DoubleHistogram::lowestEquivalentValue(double value) const
+{
+    return integerValuesHistogram.lowestEquivalentValue(integerValueFor(value)) * integerToDoubleValueConversionRatio;
+}
+
+double DoubleHistogram::highestEquivalentValue(double value) const
+{
+    return integerValuesHistogram.highestEquivalentValue(integerValueFor(value)) * integerToDoubleValueConversionRatio;
+}
+
+double DoubleHistogram::sizeOfEquivalentRange(double value) const
+{
+    return integerValuesHistogram.sizeOfEquivalentRange(integerValueFor(value)) * integerToDoubleValueConversionRatio;
+}
+
+double DoubleHistogram::getValueAtPercentile(double percentile) const
+{
+    return integerValuesHistogram.getValueAtPercentile(percentile) * integerToDoubleValueConversionRatio;
+}
+
+double DoubleHistogram::getPercentileAtOrBelowValue(double value) const
+{
+    return integerValuesHistogram.getPercentileAtOrBelowValue(integerValueFor(value));
+}
+
+int64_t DoubleHistogram::getCountBetweenValues(double lo, double hi) const
+{
+    return integerValuesHistogram.getCountBetweenValues(integerValueFor(lo), integerValueFor(hi));
+}
+
+bool DoubleHistogram::valuesAreEquivalent(double a, double b) const
+{
+    return lowestEquivalentValue(a) == lowestEquivalentValue(b);
+}
+
+/////////////////// Value Recording /////////////////////
+
+bool DoubleHistogram::recordValue(double value)
+{
+    return recordValueWithCount(value, 1);
+}
+
+bool DoubleHistogram::recordValueWithCount(double value, int64_t count)
+{
+    // Values arrive from outside, so those no range can hold are refused
+    // rather than asserted against.
+    if (!isfinite(value) || value < 0.0)
+    {
+        return false;
+    }
+
+    // Two compares against the current range; only a value outside it pays
+    // for the range to be moved.
+    if (value != 0.0 && (value < minNonZeroValue || value > maxValue))
+    {
+        auto integerValue = value * doubleToIntegerValueConversionRatio;
+        if ((integerValue < lowestTrackingIntegerValue || integerValue >= highestTrackingIntegerValue) &&
+            !autoAdjustRangeForValue(value))
+        {
+            return false;
+        }
+        minNonZeroValue = (0.0 == minNonZeroValue || value < minNonZeroValue) ? value : minNonZeroValue;
+        maxValue = (value > maxValue) ? value : maxValue;
+    }
+
+    integerValuesHistogram.recordValueWithCount(integerValueFor(value), count);
+    return true;
+}
+
+void DoubleHistogram::reset()
+{
+    integerValuesHistogram.reset();
+    minNonZeroValue = 0.0;
+    maxValue = 0.0;
+}
+
+int64_t DoubleHistogram::integerValueFor(double value) const
+{
+    return (int64_t) (value * doubleToIntegerValueConversionRatio);
+}
+
+/////////////////// Auto Ranging /////////////////////
+
+// Moves the range to take in value, or returns false, leaving it alone, if
+// that would push the values already recorded out of the other end.
+bool DoubleHistogram::autoAdjustRangeForValue(double value)
+{
+    int32_t valueMagnitude = ilogb(value);
+    int32_t lowestMagnitude = ilogb((double) lowestTrackingIntegerValue);
+
+    // Nothing recorded yet: put the value at the bottom of the range, which
+    // leaves the whole ratio above it.
+    if (0.0 == minNonZeroValue)
+    {
+        setConversionRatioMagnitude(lowestMagnitude - valueMagnitude);
+        return true;
+    }
+
+    auto integerValue = value * doubleToIntegerValueConversionRatio;
+    if (integerValue < lowestTrackingIntegerValue)
+    {
+        // Too small: scale everything up until the value reaches the bottom.
+        auto shift = lowestMagnitude - ilogb(integerValue);
+        if ((maxValue * doubleToIntegerValueConversionRatio) * ldexp(1.0, shift) >= highestTrackingIntegerValue)
+        {
+            return false;
+        }
+        shiftIntegerValues(shift);
+    }
+    else
+    {
+        // Too large: scale everything down until the value fits under the top.
+        auto shift = ilogb(integerValue) - ilogb((double) highestTrackingIntegerValue) + 1;
+        if ((minNonZeroValue * doubleToIntegerValueConversionRatio) * ldexp(1.0, -shift) < lowestTrackingIntegerValue)
+        {
+            return false;
+        }
+        shiftIntegerValues(-shift);
+    }
+    return true;
+}
+
+void DoubleHistogram::setConversionRatioMagnitude(int32_t magnitude)
+{
+    doubleToIntegerValueConversionRatio = ldexp(1.0, magnitude);
+    integerToDoubleValueConversionRatio = ldexp(1.0, -magnitude);
+}
+
+// Multiplies every recorded value by 2^shift.  Each non-zero count is at or
+// above lowestTrackingIntegerValue, where shifting a value by one bit moves it
+// exactly one bucket, so this re-buckets without losing precision, at the
+// cost of one pass over the occupied counts.
+void DoubleHistogram::shiftIntegerValues(int32_t shift)
+{
+    Histogram shifted{ highestTrackingIntegerValue, numberOfSignificantValueDigits };
+
+    integerValuesHistogram.forAll([&] (int64_t value, int64_t count)
+    {
+        if (0 != count)
+        {
+            shifted.recordValueWithCount((shift >= 0) ? (value << shift) : (value >> -shift), count);
+        }
+    });
+
+    integerValuesHistogram = std::move(shifted);
+    setConversionRatioMagnitude(ilogb(doubleToIntegerValueConversionRatio) + shift);
+}
@@ -0,0 +1,76 @@
+
+// Required includes
+// #include <stdint.h>
+// #include <math.h>
+// #include <iostream>
+// #include <memory>
+// #include <vector>
+// #include <limits>
+// #include <algorithm>
+// #include <functional>
+// #include <iterator>
+// #include <assert.h>
+// #include "histogram.h"
+
+// Histogram of non-negative floating point values, such as ratios or
+// throughputs, built on an integer Histogram.  Values are scaled into the
+// integer histogram by a power of two conversion ratio.  Only the ratio
+// between the largest and smallest non-zero values is fixed up front; where
+// that range sits is found from the values as they arrive, by shifting the
+// integer counts a whole number of buckets when a value falls outside it.
+// Precision is numberOfSignificantValueDigits across the whole range.
+class DoubleHistogram final
+{
+
+public:
+
+    DoubleHistogram(int64_t highestToLowestValueRatio,
+                    int64_t numberOfSignificantValueDigits);
+    ~DoubleHistogram();
+
+    int64_t getHighestToLowestValueRatio() const;
+    int64_t getNumberOfSignificantValueDigits() const;
+    int64_t getTotalCount() const;
+    int64_t getCountAtValue(double value) const;
+
+    double getCurrentLowestTrackableNonZeroValue() const;
+    double getCurrentHighestTrackableValue() const;
+
+    double getMaxValue() const;
+    double getMinValue() const;
+    double getMeanValue() const;
+    double getStdDeviation() const;
+    double lowestEquivalentValue(double value) const;
+    double highestEquivalentValue(double value) const;
+    double sizeOfEquivalentRange(double value) const;
+    double getValueAtPercentile(double percentile) const;
+    double getPercentileAtOrBelowValue(double value) const;
+    int64_t getCountBetweenValues(double lo, double hi) const;
+
+    // Returns false, recording nothing, for a value that cannot be brought
+    // into range without losing values already recorded: one further than
+    // highestToLowestValueRatio from them, and for negative, infinite or NaN
+    // values.
+    bool recordValue(double value);
+    bool recordValueWithCount(double value, int64_t count);
+    void reset();
+
+    bool valuesAreEquivalent(double a, double b) const;
+
+private:
+    int64_t highestToLowestValueRatio;
+    int64_t numberOfSignificantValueDigits;
+    int64_t lowestTrackingIntegerValue;
+    int64_t highestTrackingIntegerValue;
+    double doubleToIntegerValueConversionRatio;
+    double integerToDoubleValueConversionRatio;
+    double minNonZeroValue;
+    double maxValue;
+    Histogram integerValuesHistogram;
+
+    int64_t integerValueFor(double value) const;
+    bool autoAdjustRangeForValue(double value);
+    void setConversionRatioMagnitude(int32_t magnitude);
+    void shiftIntegerValues(int32_t shift);
+
+};
@@ -3,13 +3,22 @@
 #include <x86intrin.h>
 #include <math.h>
 #include <assert.h>
+#include <string.h>
+#include <zlib.h>
 
 #include <iostream>
 #include <iomanip>
+#include <memory>
 #include <vector>
 #include <functional>
+#include <iterator>
+#include <limits>
+#include <algorithm>
+#include <thread>
+#include <atomic>
 
 #include "histogram.h"
+#include "atomic_histogram.h"
 
 static int64_t power(int64_t base, int64_t exp)
 {
@@ -21,12 +30,34 @@ static int64_t power(int64_t base, int64_t exp)
     return result;
 }
 
-static inline int64_t valueFromIndex(int32_t bucketIndex, int32_t subBucketIndex)
+static int32_t floorLog2(int64_t value)
 {
-    return ((int64_t) subBucketIndex) << bucketIndex;
+    return 63 - (int32_t) __lzcnt64(value);
 }
 
-Histogram::HistogramValue::HistogramValue() :
+static int32_t subBucketHalfCountMagnitudeFor(int64_t numberOfSignificantValueDigits)
+{
+    auto largestValueWithSingleUnitResolution = 2 * power(10, numberOfSignificantValueDigits);
+    auto subBucketCountMagnitude = (int32_t) ceil(log(largestValueWithSingleUnitResolution)/log(2));
+
+    return ((subBucketCountMagnitude > 1) ? subBucketCountMagnitude : 1) - 1;
+}
+
+// determine exponent range needed to support the trackable value with no overflow:
+static int32_t bucketsNeededFor(int64_t highestTrackableValue, int32_t subBucketCount, int32_t unitMagnitude)
+{
+    auto trackableValue = (((int64_t) subBucketCount) << unitMagnitude) - 1;
+    auto bucketsNeeded = 1;
+    while (trackableValue < highestTrackableValue)
+    {
+        trackableValue <<= 1;
+        bucketsNeeded++;
+    }
+    return bucketsNeeded;
+}
+
+template <typename CountType>
+BasicHistogram<CountType>::HistogramValue::HistogramValue() :
     valueIteratedTo{ 0 },
     valueIteratedFrom{ 0 },
     countAtValueIteratedTo{ 0 },
@@ -38,129 +69,122 @@ Histogram::HistogramValue::HistogramValue() :
 {
 }
 
-Histogram::HistogramValue::~HistogramValue()
+template <typename CountType>
+BasicHistogram<CountType>::HistogramValue::~HistogramValue()
+{
+}
+
+template <typename CountType>
+BasicHistogram<CountType>::BasicHistogram(int64_t highestTrackableValue,
+                                          int64_t numberOfSignificantValueDigits) :
+    BasicHistogram{ 1, highestTrackableValue, numberOfSignificantValueDigits }
 {
 }
 
-Histogram::Histogram(int64_t highestTrackableValue,
-                     int64_t numberOfSignificantValueDigits) :
+template <typename CountType>
+BasicHistogram<CountType>::BasicHistogram(int64_t lowestDiscernibleValue,
+                                          int64_t highestTrackableValue,
+                                          int64_t numberOfSignificantValueDigits) :
+    lowestDiscernibleValue{ lowestDiscernibleValue },
     highestTrackableValue{ highestTrackableValue },
     numberOfSignificantValueDigits{ numberOfSignificantValueDigits },
-    counts{ 0 },
-    totalCount{ 0 }
+    totalCount{ 0 },
+    counts{},
+    autoResize{ false },
+    trackStatistics{ CountsTraits< CountType >::tracksStatistics }
 {
     init();
     counts.resize(countsArrayLength);
+    occupancy.resize(countsArrayLength);
+    resetStatistics();
 }
 
-Histogram::~Histogram()
+template <typename CountType>
+BasicHistogram<CountType>::~BasicHistogram()
 {
 }
 
-void Histogram::init()
+template <typename CountType>
+void BasicHistogram<CountType>::init()
 {
-    auto largestValueWithSingleUnitResolution = 2 * power(10, numberOfSignificantValueDigits);
-    auto subBucketCountMagnitude = (int32_t) ceil(log(largestValueWithSingleUnitResolution)/log(2));
+    assert(lowestDiscernibleValue >= 1);
+    assert(highestTrackableValue >= 2 * lowestDiscernibleValue);
 
-    subBucketHalfCountMagnitude = ((subBucketCountMagnitude > 1) ? subBucketCountMagnitude : 1) - 1;
+    // Values below lowestDiscernibleValue never need telling apart, so every
+    // value is shifted down by unitMagnitude before it is bucketed.
+    unitMagnitude = floorLog2(lowestDiscernibleValue);
+
+    subBucketHalfCountMagnitude = subBucketHalfCountMagnitudeFor(numberOfSignificantValueDigits);
 
     subBucketCount     = (int32_t) pow(2, (subBucketHalfCountMagnitude + 1));
     subBucketHalfCount = subBucketCount / 2;
-    subBucketMask      = subBucketCount - 1;
+    subBucketMask      = ((int64_t) subBucketCount - 1) << unitMagnitude;
 
-    // determine exponent range needed to support the trackable value with no overflow:
-    auto trackableValue = (int64_t) subBucketCount - 1;
-    auto bucketsNeeded = 1;
-    while (trackableValue < highestTrackableValue)
-    {
-        trackableValue <<= 1;
-        bucketsNeeded++;
-    }
-    bucketCount = bucketsNeeded;
+    bucketCount = bucketsNeededFor(highestTrackableValue, subBucketCount, unitMagnitude);
     countsArrayLength = (bucketCount + 1) * (subBucketCount / 2);
 }
 
 /////////////////// Properties /////////////////////
 
-int64_t Histogram::getHighestTrackableValue() const
+template <typename CountType>
+int64_t BasicHistogram<CountType>::getLowestDiscernibleValue() const
+{
+    return lowestDiscernibleValue;
+}
+
+template <typename CountType>
+int64_t BasicHistogram<CountType>::getHighestTrackableValue() const
 {
     return highestTrackableValue;
 }
 
-int64_t Histogram::getNumberOfSignificantValueDigits() const
+template <typename CountType>
+int64_t BasicHistogram<CountType>::getNumberOfSignificantValueDigits() const
 {
     return numberOfSignificantValueDigits;
 }
 
-int64_t Histogram::getTotalCount() const
+template <typename CountType>
+int64_t BasicHistogram<CountType>::getTotalCount() const
 {
     return totalCount;
 }
 
-void Histogram::forAll(std::function<void (const int64_t value, const int64_t count)> func) const
+template <typename CountType>
+int32_t BasicHistogram<CountType>::getCountsWordSize() const
 {
-    int32_t bucketIndex      = 0;
-    int32_t subBucketIndex   = 0;
-    int32_t countToIndex     = 0;
-    int64_t valueAtThisIndex = 0;
-
-    while (countToIndex < totalCount)
-    {
-        auto countAtThisIndex = getCountAtIndex(bucketIndex, subBucketIndex);
-
-        func(valueAtThisIndex, countAtThisIndex);
-
-        countToIndex += countAtThisIndex;
-        subBucketIndex++;
+    return counts.wordSize();
+}
 
-        if (subBucketIndex >= subBucketCount)
-        {
-            subBucketIndex = subBucketHalfCount;
-            bucketIndex++;
-        }
+template <typename CountType>
+size_t BasicHistogram<CountType>::getEstimatedFootprintInBytes() const
+{
+    return sizeof(*this) + counts.footprintInBytes() + occupancy.footprintInBytes();
+}
 
-        valueAtThisIndex = valueFromIndex(bucketIndex, subBucketIndex);
-    }
+template <typename CountType>
+void BasicHistogram<CountType>::forAll(std::function<void (const int64_t value, const int64_t count)> func) const
+{
+    forAll([&] (int64_t value, int64_t count)
+    {
+        func(value, count);
+    });
 }
 
-void Histogram::forPercentiles(const int32_t tickPerHalfDistance,
+template <typename CountType>
+void BasicHistogram<CountType>::forPercentiles(const int32_t tickPerHalfDistance,
                                std::function<void (const double percentileTo,
                                                    const int64_t value,
                                                    const int64_t count)> func) const
 {
-    const int64_t totalCount = getTotalCount();
-
-    double  percentileToIterateTo    = 0.0;
-    int64_t totalCountToCurrentIndex = 0;
-    int64_t totalValueToCurrentIndex = 0;
-    int64_t currentValue             = 0;
-    bool    freshSubBucket           = true;
-
-    forAll([&] (int64_t value, int64_t count)
+    forPercentiles(tickPerHalfDistance, [&] (double percentileTo, int64_t value, int64_t count)
     {
-        totalCountToCurrentIndex += count;
-        totalValueToCurrentIndex += count * medianEquivalentValue(value);
-
-        while (count != 0 && percentileToIterateTo <= (100.0 * (double) totalCountToCurrentIndex) / totalCount)
-        {
-            currentValue = highestEquivalentValue(value);
-
-            func(percentileToIterateTo, currentValue, totalCountToCurrentIndex);
-
-            if (totalCountToCurrentIndex >= totalCount)
-            {
-                break;
-            }
-
-            int64_t percentileReportingTicks = tickPerHalfDistance * (int64_t) pow(2, (int64_t) (log(100 / (100.0 - (percentileToIterateTo))) / log(2)) + 1);
-            percentileToIterateTo += 100.0 / percentileReportingTicks;
-        }
+        func(percentileTo, value, count);
     });
-
-    func(100.0, currentValue, totalCountToCurrentIndex);
 }
 
-void Histogram::outputPercentileValues(std::ostream& out, int tickPerHalfDistance, double unitScalingValue)
+template <typename CountType>
+void BasicHistogram<CountType>::outputPercentileValues(std::ostream& out, int tickPerHalfDistance, double unitScalingValue)
 {
     out << "Value, Percentile, TotalCountIncludingThisValue" << std::endl << std::endl;
 
@@ -175,7 +199,7 @@ void Histogram::outputPercentileValues(std::ostream& out, int tickPerHalfDistanc
     });
 
     double mean  = getMeanValue() / unitScalingValue;
-    double stddev = 0.0 / unitScalingValue;
+    double stddev = getStdDeviation() / unitScalingValue;
     double max = getMaxValue() / unitScalingValue;
 
     out << "#[Mean    = " << std::setw(12) << std::setprecision(numberOfSignificantValueDigits) << std::fixed << mean
@@ -194,38 +218,52 @@ void Histogram::outputPercentileValues(std::ostream& out, int tickPerHalfDistanc
 
 }
 
-int64_t Histogram::getMaxValue() const
+template <typename CountType>
+int64_t BasicHistogram<CountType>::getMaxValue() const
 {
-    int64_t maxValue = 0;
+    if (trackStatistics)
+    {
+        return (0 == totalCount) ? 0 : valueFromCountsIndex(maxCountsIndex);
+    }
 
-    forAll([&] (int64_t value, int64_t count)
+    for (auto i = occupancy.previousOccupied(countsArrayLength - 1); i >= 0; i = occupancy.previousOccupied(i - 1))
     {
-        if (0 != count)
+        if (0 != counts.get(i))
         {
-            maxValue = value;
+            return valueFromCountsIndex(i);
         }
-    });
+    }
 
-    return maxValue;
+    return 0;
 }
 
-int64_t Histogram::getMinValue() const
+template <typename CountType>
+int64_t BasicHistogram<CountType>::getMinValue() const
 {
-    int64_t minValue = 0;
+    if (trackStatistics)
+    {
+        return (0 == totalCount) ? 0 : valueFromCountsIndex(minCountsIndex);
+    }
 
-    forAll([&] (int64_t value, int64_t count)
+    for (auto i = occupancy.nextOccupied(0); i < countsArrayLength; i = occupancy.nextOccupied(i + 1))
     {
-        if (0 != count && 0 == minValue)
+        if (0 != counts.get(i))
         {
-            minValue = value;
+            return valueFromCountsIndex(i);
         }
-    });
+    }
 
-    return minValue;
+    return 0;
 }
 
-double Histogram::getMeanValue() const
+template <typename CountType>
+double BasicHistogram<CountType>::getMeanValue() const
 {
+    if (trackStatistics)
+    {
+        return (sumOfValues * 1.0) / totalCount;
+    }
+
     int64_t totalValue = 0;
 
     forAll([&] (int64_t value, int64_t count)
@@ -239,33 +277,169 @@ double Histogram::getMeanValue() const
     return (totalValue * 1.0) / totalCount;
 }
 
-int64_t Histogram::getValueAtPercentile(double requestedPercentile) const
+template <typename CountType>
+double BasicHistogram<CountType>::getStdDeviation() const
 {
-    auto percentile        = fmin(fmax(requestedPercentile, 0), 100.0);
-    auto countAtPercentile = (int64_t) (((percentile / 100.0) * totalCount) + 0.5);
-    countAtPercentile      = (int64_t) countAtPercentile > 1 ? countAtPercentile : 1;
+    if (0 == totalCount)
+    {
+        return 0.0;
+    }
+
+    double mean = getMeanValue();
+
+    if (trackStatistics)
+    {
+        double variance = (sumOfValuesSquared / totalCount) - (mean * mean);
+        return (variance > 0.0) ? sqrt(variance) : 0.0;
+    }
+
+    double geometricDeviationTotal = 0.0;
+
+    forAll([&] (int64_t value, int64_t count)
+    {
+        if (0 != count)
+        {
+            double deviation = medianEquivalentValue(value) - mean;
+            geometricDeviationTotal += (deviation * deviation) * count;
+        }
+    });
+
+    return sqrt(geometricDeviationTotal / totalCount);
+}
+
+template <typename CountType>
+int64_t BasicHistogram<CountType>::getValueAtPercentile(double requestedPercentile) const
+{
+    auto countAtPercentile = this->countAtPercentile(requestedPercentile);
+
+    if (!rankIndex.empty())
+    {
+        auto countsIndex = indexForCountAtOrBelow(countAtPercentile);
+        return (countsIndex < countsArrayLength) ? valueFromCountsIndex(countsIndex) : 0;
+    }
+
+    int64_t totalToCurrentIndex = 0;
+    for (auto i = occupancy.nextOccupied(0); i < countsArrayLength; i = occupancy.nextOccupied(i + 1))
+    {
+        totalToCurrentIndex += counts.get(i);
+        if (totalToCurrentIndex >= countAtPercentile)
+        {
+            return valueFromCountsIndex(i);
+        }
+    }
+
+    return 0;
+}
+
+template <typename CountType>
+void BasicHistogram<CountType>::getValuesAtPercentiles(const double* percentiles, size_t length, int64_t* values) const
+{
+    if (!rankIndex.empty())
+    {
+        for (size_t i = 0; i < length; i++)
+        {
+            values[i] = getValueAtPercentile(percentiles[i]);
+        }
+        return;
+    }
+
+    sweepPercentiles(percentiles, length, values, nullptr);
+}
+
+template <typename CountType>
+void BasicHistogram<CountType>::getPercentileSummary(const double* percentiles, size_t length, int64_t* values,
+                                                     HistogramSummary& summary) const
+{
+    if (!trackStatistics && rankIndex.empty())
+    {
+        sweepPercentiles(percentiles, length, values, &summary);
+        return;
+    }
+
+    getValuesAtPercentiles(percentiles, length, values);
+
+    summary.totalCount = totalCount;
+    summary.minValue   = getMinValue();
+    summary.maxValue   = getMaxValue();
+    summary.meanValue  = getMeanValue();
+}
+
+// Answers every requested percentile in a single forward sweep: the targets
+// are visited in ascending order, so the counts are walked once however many
+// percentiles are asked for.  When a summary is wanted the sweep carries on
+// to the last count to pick up the min, max and mean as well.
+template <typename CountType>
+void BasicHistogram<CountType>::sweepPercentiles(const double* percentiles, size_t length, int64_t* values,
+                                                 HistogramSummary* summary) const
+{
+    std::vector< size_t > order(length);
+    for (size_t i = 0; i < length; i++)
+    {
+        order[i] = i;
+        values[i] = 0;
+    }
+    std::sort(order.begin(), order.end(), [&] (size_t a, size_t b)
+    {
+        return percentiles[a] < percentiles[b];
+    });
+
+    size_t nextTarget = 0;
+    int32_t minIndex = -1;
+    int32_t maxIndex = -1;
+    int64_t totalValue = 0;
+    int64_t totalToCurrentIndex = 0;
 
-    auto totalToCurrentIJ = 0UL;
-    for (int32_t i = 0; i < bucketCount; i++)
+    for (auto i = occupancy.nextOccupied(0);
+         i < countsArrayLength && totalToCurrentIndex < totalCount;
+         i = occupancy.nextOccupied(i + 1))
     {
-        int32_t j = (i == 0) ? 0 : (subBucketCount / 2);
-        for (; j < subBucketCount; j++)
+        auto count = counts.get(i);
+        if (0 == count)
         {
-            totalToCurrentIJ += getCountAtIndex(i, j);
-            if (totalToCurrentIJ >= countAtPercentile)
+            continue;
+        }
+
+        totalToCurrentIndex += count;
+        while (nextTarget < length && totalToCurrentIndex >= countAtPercentile(percentiles[order[nextTarget]]))
+        {
+            values[order[nextTarget]] = valueFromCountsIndex(i);
+            nextTarget++;
+        }
+
+        if (nullptr == summary)
+        {
+            if (nextTarget == length)
             {
-                return valueFromIndex(i, j);
+                return;
             }
+            continue;
         }
+
+        minIndex = (minIndex < 0) ? i : minIndex;
+        maxIndex = i;
+        totalValue += count * medianValueFromCountsIndex(i);
     }
 
-    return 0;
+    if (nullptr != summary)
+    {
+        summary->totalCount = totalCount;
+        summary->minValue   = (minIndex < 0) ? 0 : valueFromCountsIndex(minIndex);
+        summary->maxValue   = (maxIndex < 0) ? 0 : valueFromCountsIndex(maxIndex);
+        summary->meanValue  = (totalValue * 1.0) / totalCount;
+    }
 }
 
-double Histogram::getPercentileAtOrBelowValue(int64_t value) const
+template <typename CountType>
+int64_t BasicHistogram<CountType>::countAtPercentile(double requestedPercentile) const
 {
-    auto totalToCurrentIJ = 0ULL;
+    auto percentile        = fmin(fmax(requestedPercentile, 0), 100.0);
+    auto countAtPercentile = (int64_t) (((percentile / 100.0) * totalCount) + 0.5);
+    return countAtPercentile > 1 ? countAtPercentile : 1;
+}
 
+template <typename CountType>
+double BasicHistogram<CountType>::getPercentileAtOrBelowValue(int64_t value) const
+{
     auto targetBucketIndex    = getBucketIndex(value);
     auto targetSubBucketIndex = getSubBucketIndex(value, targetBucketIndex);
 
@@ -274,60 +448,57 @@ double Histogram::getPercentileAtOrBelowValue(int64_t value) const
         return 100.0;
     }
 
-    for (int32_t i = 0; i <= targetBucketIndex; i++)
+    auto countsIndex = countsArrayIndex(targetBucketIndex, targetSubBucketIndex);
+    if (!rankIndex.empty())
     {
-        auto j = (i == 0) ? 0 : (subBucketCount / 2);
-        auto subBucketCap = (i == targetBucketIndex) ? (targetSubBucketIndex + 1) : subBucketCount;
-
-        for (; j < subBucketCap; j++)
-        {
-            totalToCurrentIJ += getCountAtIndex(i, j);
-        }
+        return (100.0 * countAtOrBelowIndex(countsIndex)) / getTotalCount();
     }
 
-    return (100.0 * totalToCurrentIJ) / getTotalCount();
+    return (100.0 * countBetweenIndices(0, countsIndex)) / getTotalCount();
 }
 
-int64_t Histogram::getCountBetweenValues(int64_t lo, int64_t hi) const
+template <typename CountType>
+int64_t BasicHistogram<CountType>::getCountBetweenValues(int64_t lo, int64_t hi) const
 {
-    auto count = 0ULL;
-
     auto loBucketIndex    = getBucketIndex(lo);
     auto loSubBucketIndex = getSubBucketIndex(lo, loBucketIndex);
-    auto valueAtLo        = valueFromIndex(loBucketIndex, loSubBucketIndex);
 
     auto hiBucketIndex    = getBucketIndex(hi);
     auto hiSubBucketIndex = getSubBucketIndex(hi, hiBucketIndex);
-    auto valueAtHi        = valueFromIndex(hiBucketIndex, hiSubBucketIndex);
 
     if (loBucketIndex >= bucketCount || hiBucketIndex >= bucketCount)
     {
         return 0;
     }
 
-    for (auto i = loBucketIndex; i <= hiBucketIndex; i++)
+    auto loCountsIndex = countsArrayIndex(loBucketIndex, loSubBucketIndex);
+    auto hiCountsIndex = countsArrayIndex(hiBucketIndex, hiSubBucketIndex);
+    if (!rankIndex.empty())
     {
-        auto j = (i == 0) ? 0 : (subBucketCount / 2);
-        for (; j < subBucketCount; j++)
-        {
-            auto valueAtIndex = valueFromIndex(i, j);
-            if (valueAtIndex > valueAtHi)
-            {
-                return count;
-            }
-            if (valueAtIndex >= valueAtLo)
-            {
-                count += getCountAtIndex(i, j);
-            }
-        }
+        return (loCountsIndex > hiCountsIndex) ? 0 :
+            countAtOrBelowIndex(hiCountsIndex) - countAtOrBelowIndex(loCountsIndex - 1);
     }
 
+    return countBetweenIndices(loCountsIndex, hiCountsIndex);
+}
+
+// Sum of the counts from fromIndex to toIndex inclusive, visiting only the
+// occupied blocks.
+template <typename CountType>
+int64_t BasicHistogram<CountType>::countBetweenIndices(int32_t fromIndex, int32_t toIndex) const
+{
+    int64_t count = 0;
+    for (auto i = occupancy.nextOccupied(fromIndex); i <= toIndex; i = occupancy.nextOccupied(i + 1))
+    {
+        count += counts.get(i);
+    }
     return count;
 }
 
 /////////////////// Index Calcuations /////////////////////
 
-int32_t Histogram::countsIndexFor(int64_t value) const
+template <typename CountType>
+int32_t BasicHistogram<CountType>::countsIndexFor(int64_t value) const
 {
     auto bucketIndex    = getBucketIndex(value);
     auto subBucketIndex = getSubBucketIndex(value, bucketIndex);
@@ -336,22 +507,35 @@ int32_t Histogram::countsIndexFor(int64_t value) const
     return countsIndex;
 }
 
-int64_t Histogram::getCountAtValue(int64_t value) const
+// countsIndexFor, growing the counts first if the value is out of range and
+// the histogram auto-resizes.  The check is a single, almost never taken,
+// branch.
+template <typename CountType>
+int32_t BasicHistogram<CountType>::countsIndexForRecording(int64_t value)
 {
-    return counts[countsIndexFor(value)];
+    auto bucketIndex = getBucketIndex(value);
+    if (bucketIndex >= bucketCount)
+    {
+        resizeToBucket(bucketIndex);
+    }
+
+    return countsArrayIndex(bucketIndex, getSubBucketIndex(value, bucketIndex));
 }
 
-int64_t Histogram::getCountAtIndex(int32_t bucketIndex, int32_t subBucketIndex) const
+template <typename CountType>
+int64_t BasicHistogram<CountType>::getCountAtValue(int64_t value) const
 {
-    return counts[countsArrayIndex(bucketIndex, subBucketIndex)];
+    return counts.get(countsIndexFor(value));
 }
 
-int32_t Histogram::getSubBucketIndex(int64_t value, int32_t bucketIndex) const
+template <typename CountType>
+int32_t BasicHistogram<CountType>::getSubBucketIndex(int64_t value, int32_t bucketIndex) const
 {
-    return (int32_t)(value >> bucketIndex);
+    return (int32_t)(value >> (bucketIndex + unitMagnitude));
 }
 
-int32_t Histogram::countsArrayIndex(int32_t bucketIndex, int32_t subBucketIndex) const
+template <typename CountType>
+int32_t BasicHistogram<CountType>::countsArrayIndex(int32_t bucketIndex, int32_t subBucketIndex) const
 {
     assert(subBucketIndex < subBucketCount);
     assert(bucketIndex < bucketCount);
@@ -366,98 +550,1426 @@ int32_t Histogram::countsArrayIndex(int32_t bucketIndex, int32_t subBucketIndex)
     return bucketBaseIndex + offsetInBucket;
 }
 
-/////////////////// Value Recording /////////////////////
+/////////////////// Batch Index Calculations /////////////////////
+
+// Both kernels use countsArrayIndex folded into a single expression:
+//   ((bucketIndex + 1) << subBucketHalfCountMagnitude) + subBucketIndex - subBucketHalfCount
+// == (bucketIndex << subBucketHalfCountMagnitude) + (value >> (bucketIndex + unitMagnitude))
 
-void Histogram::recordValue(int64_t value)
+typedef void (*CountsIndicesKernel)(const int64_t* values, size_t length, int32_t* indices,
+                                    int64_t subBucketMask, int32_t subBucketHalfCountMagnitude,
+                                    int32_t unitMagnitude);
+
+static void countsIndicesScalar(const int64_t* values, size_t length, int32_t* indices,
+                                int64_t subBucketMask, int32_t subBucketHalfCountMagnitude,
+                                int32_t unitMagnitude)
 {
-    incrementCountAtIndex(countsIndexFor(value));
-    incrementTotalCount();
+    for (size_t i = 0; i < length; i++)
+    {
+        int32_t bucketIndex = floorLog2(values[i] | subBucketMask) - unitMagnitude - subBucketHalfCountMagnitude;
+        indices[i] = (bucketIndex << subBucketHalfCountMagnitude) + (int32_t) (values[i] >> (bucketIndex + unitMagnitude));
+    }
 }
 
-void Histogram::recordValue(int64_t value, int64_t expectedInterval)
+__attribute__((target("avx2")))
+static void countsIndicesAvx2(const int64_t* values, size_t length, int32_t* indices,
+                              int64_t subBucketMask, int32_t subBucketHalfCountMagnitude,
+                              int32_t unitMagnitude)
 {
-    recordValue(value);
-    if (expectedInterval <= 0 || value <= expectedInterval)
+    const __m256i zero      = _mm256_setzero_si256();
+    const __m256i mask      = _mm256_set1_epi64x(subBucketMask);
+    const __m256i magnitude = _mm256_set1_epi64x(subBucketHalfCountMagnitude + unitMagnitude);
+    const __m256i unit      = _mm256_set1_epi64x(unitMagnitude);
+    const __m128i shiftBy   = _mm_cvtsi32_si128(subBucketHalfCountMagnitude);
+    const __m256i lowLanes  = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+
+    size_t i = 0;
+    for (; i + 4 <= length; i += 4)
     {
-        return;
+        __m256i value = _mm256_loadu_si256((const __m256i*) (values + i));
+        __m256i x     = _mm256_or_si256(value, mask);
+
+        // There is no 64 bit lzcnt in AVX2, so find the highest set bit with
+        // a branch free binary search: halve the window while it is non zero.
+        __m256i highestBit = zero;
+        for (int32_t shift = 32; shift > 0; shift >>= 1)
+        {
+            __m256i shifted = _mm256_srl_epi64(x, _mm_cvtsi32_si128(shift));
+            __m256i isZero  = _mm256_cmpeq_epi64(shifted, zero);
+            x          = _mm256_blendv_epi8(shifted, x, isZero);
+            highestBit = _mm256_add_epi64(highestBit, _mm256_andnot_si256(isZero, _mm256_set1_epi64x(shift)));
+        }
+
+        __m256i bucketIndex    = _mm256_sub_epi64(highestBit, magnitude);
+        __m256i subBucketIndex = _mm256_srlv_epi64(value, _mm256_add_epi64(bucketIndex, unit));
+        __m256i countsIndex    = _mm256_add_epi64(_mm256_sll_epi64(bucketIndex, shiftBy), subBucketIndex);
+
+        // Indices fit in 32 bits, keep the low half of each lane.
+        __m256i packed = _mm256_permutevar8x32_epi32(countsIndex, lowLanes);
+        _mm_storeu_si128((__m128i*) (indices + i), _mm256_castsi256_si128(packed));
     }
-    int64_t missingValue = value - expectedInterval;
-    for (; missingValue >= expectedInterval; missingValue -= expectedInterval)
+
+    countsIndicesScalar(values + i, length - i, indices + i, subBucketMask, subBucketHalfCountMagnitude, unitMagnitude);
+}
+
+static CountsIndicesKernel selectCountsIndicesKernel()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? countsIndicesAvx2 : countsIndicesScalar;
+}
+
+static const CountsIndicesKernel countsIndicesKernel = selectCountsIndicesKernel();
+
+template <typename CountType>
+void BasicHistogram<CountType>::countsIndicesFor(const int64_t* values, size_t length, int32_t* indices) const
+{
+    countsIndicesKernel(values, length, indices, subBucketMask, subBucketHalfCountMagnitude, unitMagnitude);
+}
+
+/////////////////// Value Recording /////////////////////
+
+template <typename CountType>
+void BasicHistogram<CountType>::recordValue(int64_t value)
+{
+    auto countsIndex = countsIndexForRecording(value);
+
+    incrementCountAtIndex(countsIndex);
+    incrementTotalCount();
+
+    if (trackStatistics)
+    {
+        updateStatistics(countsIndex, 1);
+    }
+    if (!rankIndex.empty())
     {
-        recordValue(missingValue);
+        addToRankIndex(countsIndex, 1);
     }
 }
 
+template <typename CountType>
+void BasicHistogram<CountType>::recordValueSingleWriter(int64_t value)
+{
+    recordValue(value);
+}
 
-int32_t Histogram::getBucketIndex(int64_t value) const
+template <typename CountType>
+void BasicHistogram<CountType>::recordValueWithCount(int64_t value, int64_t count)
 {
-    auto pow2ceiling = 64 - __lzcnt64(value | subBucketMask); // smallest power of 2 containing value
-    return pow2ceiling - (subBucketHalfCountMagnitude + 1);
+    recordCountAtIndex(countsIndexForRecording(value), count);
 }
 
-void Histogram::incrementCountAtIndex(int32_t countsIndex)
+template <typename CountType>
+void BasicHistogram<CountType>::recordValue(int64_t value, int64_t expectedInterval)
 {
-    counts[countsIndex]++;
+    recordValue(value);
+    recordMissingValues(value, 1, expectedInterval);
 }
 
-void Histogram::incrementTotalCount()
+// Records count of each value that coordinated omission hid behind a value
+// taking longer than expectedInterval: value - k * expectedInterval for every
+// k >= 1 that leaves it >= expectedInterval.  Rather than record them one at
+// a time, work down from the largest and add all those that share its
+// sub-bucket in one step, so the cost follows the sub-buckets touched.
+template <typename CountType>
+void BasicHistogram<CountType>::recordMissingValues(int64_t value, int64_t count, int64_t expectedInterval)
 {
-    totalCount++;
+    if (expectedInterval <= 0 || value <= expectedInterval)
+    {
+        return;
+    }
+
+    int64_t missingValue = value - expectedInterval;
+    while (missingValue >= expectedInterval)
+    {
+        auto lowestInSubBucket = lowestEquivalentValue(missingValue);
+        auto lowestMissing     = (lowestInSubBucket > expectedInterval) ? lowestInSubBucket : expectedInterval;
+        auto missingCount      = ((missingValue - lowestMissing) / expectedInterval) + 1;
+
+        recordCountAtIndex(countsIndexFor(missingValue), missingCount * count);
+        missingValue -= missingCount * expectedInterval;
+    }
 }
 
-/////////////////// Utility /////////////////////
+/////////////////// Adding Histograms /////////////////////
+
+// Element-wise sum (sign 1) or difference (sign -1) of the counts from
+// fromIndex up to toIndex, returning the sum of the counts read from from.
+// That, rather than from's total count, is what the total changes by, so the
+// two agree even when from is being recorded into.  The generic form skips
+// zero counts, which keeps the packed and auto-promoting storage from
+// touching pages or widening needlessly.
+template <typename CountType>
+static int64_t addCountsArray(CountsArray< CountType >& to, const CountsArray< CountType >& from,
+                              int32_t fromIndex, int32_t toIndex, int64_t sign)
+{
+    int64_t added = 0;
+    for (int32_t i = fromIndex; i < toIndex; i++)
+    {
+        auto count = from.get(i);
+        if (0 != count)
+        {
+            to.add(i, sign * count);
+            added += count;
+        }
+    }
+    return added;
+}
+
+typedef int64_t (*AddCountsKernel)(int64_t* to, const int64_t* from, int32_t length, int64_t sign);
 
-bool Histogram::valuesAreEquivalent(int64_t a, int64_t b) const
+static int64_t addCountsScalar(int64_t* to, const int64_t* from, int32_t length, int64_t sign)
 {
-    return lowestEquivalentValue(a) == lowestEquivalentValue(b);
+    int64_t added = 0;
+    for (int32_t i = 0; i < length; i++)
+    {
+        to[i] += sign * from[i];
+        added += from[i];
+    }
+    return added;
 }
 
-int64_t Histogram::lowestEquivalentValue(int64_t value) const
+__attribute__((target("avx2")))
+static int64_t addCountsAvx2(int64_t* to, const int64_t* from, int32_t length, int64_t sign)
 {
-    auto bucketIndex    = getBucketIndex(value);
-    auto subBucketIndex = getSubBucketIndex(value, bucketIndex);
+    int32_t i = 0;
+    __m256i added = _mm256_setzero_si256();
+    if (sign > 0)
+    {
+        for (; i + 4 <= length; i += 4)
+        {
+            __m256i counts = _mm256_loadu_si256((const __m256i*) (from + i));
+            __m256i sum = _mm256_add_epi64(_mm256_loadu_si256((const __m256i*) (to + i)), counts);
+            _mm256_storeu_si256((__m256i*) (to + i), sum);
+            added = _mm256_add_epi64(added, counts);
+        }
+    }
+    else
+    {
+        for (; i + 4 <= length; i += 4)
+        {
+            __m256i counts = _mm256_loadu_si256((const __m256i*) (from + i));
+            __m256i difference = _mm256_sub_epi64(_mm256_loadu_si256((const __m256i*) (to + i)), counts);
+            _mm256_storeu_si256((__m256i*) (to + i), difference);
+            added = _mm256_add_epi64(added, counts);
+        }
+    }
 
-    return valueFromIndex(bucketIndex, subBucketIndex);
+    int64_t lanes[4];
+    _mm256_storeu_si256((__m256i*) lanes, added);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + addCountsScalar(to + i, from + i, length - i, sign);
 }
 
-int64_t Histogram::medianEquivalentValue(int64_t value) const
+static AddCountsKernel selectAddCountsKernel()
 {
-    return lowestEquivalentValue(value) + (sizeOfEquivalentRange(value) >> 1);
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? addCountsAvx2 : addCountsScalar;
 }
 
-int64_t Histogram::highestEquivalentValue(int64_t value) const
+static const AddCountsKernel addCountsKernel = selectAddCountsKernel();
+
+static int64_t addCountsArray(CountsArray< int64_t >& to, const CountsArray< int64_t >& from,
+                              int32_t fromIndex, int32_t toIndex, int64_t sign)
 {
-    return nextNonEquivalentValue(value) - 1;
+    return addCountsKernel(to.data() + fromIndex, from.data() + fromIndex, toIndex - fromIndex, sign);
 }
 
-int64_t Histogram::nextNonEquivalentValue(int64_t value) const
+template <typename CountType>
+bool BasicHistogram<CountType>::hasSameLayoutAs(const BasicHistogram& other) const
 {
-    return lowestEquivalentValue(value) + sizeOfEquivalentRange(value);
+    return unitMagnitude == other.unitMagnitude &&
+           subBucketHalfCountMagnitude == other.subBucketHalfCountMagnitude;
 }
 
-int64_t Histogram::sizeOfEquivalentRange(int64_t value) const
+template <typename CountType>
+bool BasicHistogram<CountType>::add(const BasicHistogram& other)
 {
-    auto bucketIndex    = getBucketIndex(value);
-    auto subBucketIndex = getSubBucketIndex(value, bucketIndex);
-    int64_t distanceToNextValue = (1 << ((subBucketIndex >= subBucketCount) ? (bucketIndex + 1) : bucketIndex));
-    return distanceToNextValue;
+    return addCounts(other, 1);
 }
 
-void Histogram::print(std::ostream& stream) const
+// As in the Java implementation, nothing is taken away unless every count of
+// other is covered by ours, so no count can go negative.  Other's buckets are
+// visited in value order, so those of a finer layout that share one of ours
+// arrive together and are checked against it as a sum.
+template <typename CountType>
+bool BasicHistogram<CountType>::subtract(const BasicHistogram& other)
 {
-    stream << "identityCount: "                  << identityCount <<
-            ", highestTrackableValue: "          << highestTrackableValue <<
-            ", numberOfSignificantValueDigits: " << numberOfSignificantValueDigits <<
-            ", subBucketHalfCountMagnitude: "    << subBucketHalfCountMagnitude <<
-            ", subBucketHalfCount: "             << subBucketHalfCount <<
-            ", subBucketMask: "                  << subBucketMask <<
-            ", subBucketCount: "                 << subBucketCount <<
-            ", bucketCount: "                    << bucketCount <<
-            ", countsArrayLength: "              << countsArrayLength;
+    int32_t coveringIndex = -1;
+    int64_t countToCover  = 0;
+    int64_t countToIndex  = 0;
+    for (auto i = other.occupancy.nextOccupied(0);
+         i < other.countsArrayLength && countToIndex < other.totalCount;
+         i = other.occupancy.nextOccupied(i + 1))
+    {
+        auto count = other.counts.get(i);
+        if (0 == count)
+        {
+            continue;
+        }
+        countToIndex += count;
+
+        auto value = other.valueFromCountsIndex(i);
+        if (getBucketIndex(value) >= bucketCount)
+        {
+            return false;
+        }
+        auto countsIndex = countsIndexFor(value);
+        countToCover  = (countsIndex == coveringIndex) ? countToCover + count : count;
+        coveringIndex = countsIndex;
+        if (counts.get(countsIndex) < countToCover)
+        {
+            return false;
+        }
+    }
+    return addCounts(other, -1);
 }
 
-std::ostream& operator<< (std::ostream& stream, const Histogram& histogram)
+template <typename CountType>
+bool BasicHistogram<CountType>::addCounts(const BasicHistogram& other, int64_t sign)
 {
-    histogram.print(stream);
+    // As in the Java implementation, other's largest value has to fit, or the
+    // histogram has to be able to grow to fit it.
+    if (!autoResize && 0 != other.totalCount && getBucketIndex(other.getMaxValue()) >= bucketCount)
+    {
+        return false;
+    }
+
+    if (hasSameLayoutAs(other) && other.countsArrayLength > countsArrayLength)
+    {
+        resizeToBucket(other.bucketCount - 1);
+    }
+
+    if (!hasSameLayoutAs(other) || other.countsArrayLength > countsArrayLength)
+    {
+        // Different layouts: move each non-zero bucket across by value.
+        int64_t countToIndex = 0;
+        for (auto i = other.occupancy.nextOccupied(0);
+             i < other.countsArrayLength && countToIndex < other.totalCount;
+             i = other.occupancy.nextOccupied(i + 1))
+        {
+            auto count = other.counts.get(i);
+            if (0 != count)
+            {
+                recordValueWithCount(other.valueFromCountsIndex(i), sign * count);
+                countToIndex += count;
+            }
+        }
+
+        if (sign < 0 && trackStatistics)
+        {
+            recomputeStatistics();
+        }
+        return true;
+    }
+
+    // Only the runs of blocks other has recorded to can change anything.
+    // Merging the bitmap afterwards can only mark more blocks than were read.
+    int64_t added = 0;
+    auto runStart = other.occupancy.nextOccupied(0);
+    while (runStart < other.countsArrayLength)
+    {
+        auto runEnd = other.occupancy.nextUnoccupied(runStart);
+        added += addCountsArray(counts, other.counts, runStart, runEnd, sign);
+        runStart = other.occupancy.nextOccupied(runEnd);
+    }
+    occupancy.merge(other.occupancy);
+    totalCount += sign * added;
+
+    // Index by index the layouts agree, so a sum can merge the tracked
+    // statistics directly; a difference may empty the extreme buckets.
+    if (trackStatistics)
+    {
+        if (sign > 0 && other.trackStatistics)
+        {
+            mergeStatistics(other);
+        }
+        else
+        {
+            recomputeStatistics();
+        }
+    }
+
+    rebuildRankIndex();
+    return true;
+}
+
+template <typename CountType>
+void BasicHistogram<CountType>::mergeStatistics(const BasicHistogram& other)
+{
+    if (0 != other.totalCount)
+    {
+        minCountsIndex = (other.minCountsIndex < minCountsIndex) ? other.minCountsIndex : minCountsIndex;
+        maxCountsIndex = (other.maxCountsIndex > maxCountsIndex) ? other.maxCountsIndex : maxCountsIndex;
+    }
+    sumOfValues        += other.sumOfValues;
+    sumOfValuesSquared += other.sumOfValuesSquared;
+}
+
+template <typename CountType>
+void BasicHistogram<CountType>::rebuildRankIndex()
+{
+    if (!rankIndex.empty())
+    {
+        std::vector< int64_t >().swap(rankIndex);
+        setRankIndexing(true);
+    }
+}
+
+// Worker ranges start on cache line boundaries of out's counts storage, worked
+// out from its address since a std::vector makes no alignment promise beyond
+// int64_t, so no two workers ever write to the same line.  Within its range a
+// worker walks the inputs a tile at a time, keeping the tile of out in L1, and
+// adds only the runs of each input's tile that its occupancy bitmap marks.
+static const int32_t MERGE_CACHE_LINE      = 64;
+static const int32_t MERGE_RANGE_ALIGNMENT = MERGE_CACHE_LINE / sizeof(int64_t);
+static const int32_t MERGE_TILE_LENGTH     = 1024;
+// Input counts a worker needs to sum to be worth starting: a thread takes
+// tens of microseconds to start and join, about what a quarter million counts
+// take to add, so small merges run inline on the caller's thread.
+static const int64_t MERGE_MIN_WORKER_LENGTH = 1 << 18;
+
+static void mergeCountsRange(int64_t* to, const std::vector< const OccupancyBitmap* >& inputOccupancy,
+                             const std::vector< const int64_t* >& inputCounts,
+                             const std::vector< int32_t >& inputLengths,
+                             int32_t fromIndex, int32_t toIndex)
+{
+    for (int32_t tileStart = fromIndex; tileStart < toIndex; tileStart += MERGE_TILE_LENGTH)
+    {
+        int32_t tileEnd = std::min(tileStart + MERGE_TILE_LENGTH, toIndex);
+        for (size_t i = 0; i < inputCounts.size(); i++)
+        {
+            int32_t end = std::min(tileEnd, inputLengths[i]);
+            auto runStart = inputOccupancy[i]->nextOccupied(tileStart);
+            while (runStart < end)
+            {
+                auto runEnd = std::min(inputOccupancy[i]->nextUnoccupied(runStart), end);
+                addCountsKernel(to + runStart, inputCounts[i] + runStart, runEnd - runStart, 1);
+                runStart = inputOccupancy[i]->nextOccupied(runEnd);
+            }
+        }
+    }
+}
+
+bool mergeAll(const Histogram* const* histograms, size_t length, Histogram& out, unsigned threads)
+{
+    bool added = true;
+    std::vector< const Histogram* > inputs;
+    for (size_t i = 0; i < length; i++)
+    {
+        const Histogram& histogram = *histograms[i];
+        assert(&histogram != &out);
+        if (out.hasSameLayoutAs(histogram) && histogram.countsArrayLength > out.countsArrayLength && out.autoResize)
+        {
+            out.resizeToBucket(histogram.bucketCount - 1);
+        }
+
+        if (out.hasSameLayoutAs(histogram) && histogram.countsArrayLength <= out.countsArrayLength)
+        {
+            inputs.push_back(&histogram);
+        }
+        else
+        {
+            added = out.add(histogram) && added;
+        }
+    }
+
+    std::vector< const OccupancyBitmap* > inputOccupancy;
+    std::vector< const int64_t* > inputCounts;
+    std::vector< int32_t > inputLengths;
+    int32_t mergeLength = 0;
+    int64_t inputLength = 0;
+    for (auto histogram : inputs)
+    {
+        inputOccupancy.push_back(&histogram->occupancy);
+        inputCounts.push_back(histogram->counts.data());
+        inputLengths.push_back(histogram->countsArrayLength);
+        mergeLength = std::max(mergeLength, histogram->countsArrayLength);
+        inputLength += histogram->countsArrayLength;
+    }
+
+    int64_t* to = out.counts.data();
+    int32_t ranges = (mergeLength + MERGE_RANGE_ALIGNMENT - 1) / MERGE_RANGE_ALIGNMENT;
+    int64_t worthwhileWorkers = inputLength / MERGE_MIN_WORKER_LENGTH;
+    int32_t workers = (int32_t) std::max< int64_t >(1, std::min< int64_t >({ threads, ranges, worthwhileWorkers }));
+    int32_t rangesPerWorker = (ranges + workers - 1) / workers;
+
+    // The first index whose count starts a cache line; every later worker
+    // boundary is a whole number of lines on from it.
+    int32_t firstLineIndex = (int32_t) (((MERGE_CACHE_LINE - ((uintptr_t) to % MERGE_CACHE_LINE)) % MERGE_CACHE_LINE) /
+                                        sizeof(int64_t));
+    auto boundary = [&] (int32_t worker)
+    {
+        return (0 == worker) ? 0 : std::min(firstLineIndex + worker * rangesPerWorker * MERGE_RANGE_ALIGNMENT, mergeLength);
+    };
+
+    std::vector< std::thread > pool;
+    pool.reserve(workers - 1);
+    for (int32_t worker = 1; worker < workers; worker++)
+    {
+        pool.emplace_back(mergeCountsRange, to, std::cref(inputOccupancy), std::cref(inputCounts),
+                          std::cref(inputLengths), boundary(worker), boundary(worker + 1));
+    }
+    mergeCountsRange(to, inputOccupancy, inputCounts, inputLengths, 0, boundary(1));
+    for (auto& thread : pool)
+    {
+        thread.join();
+    }
+
+    bool statisticsMerge = out.trackStatistics;
+    for (auto histogram : inputs)
+    {
+        out.occupancy.merge(histogram->occupancy);
+        out.totalCount += histogram->totalCount;
+        statisticsMerge = statisticsMerge && histogram->trackStatistics;
+        if (statisticsMerge)
+        {
+            out.mergeStatistics(*histogram);
+        }
+    }
+    if (out.trackStatistics && !statisticsMerge)
+    {
+        out.recomputeStatistics();
+    }
+    out.rebuildRankIndex();
+    return added;
+}
+
+/////////////////// Encoding /////////////////////
+
+// Cookies carry the word size in bits 4-7; 0x10 marks the ZigZag LEB128
+// counts encoding, which is the only one written or read here.
+static const int32_t V2_ENCODING_COOKIE            = 0x1c849303 | 0x10;
+static const int32_t V2_COMPRESSED_ENCODING_COOKIE = 0x1c849304 | 0x10;
+static const int32_t COOKIE_WORD_SIZE_MASK         = 0xf0;
+
+static const int32_t V2_ENCODING_HEADER_SIZE         = 40;
+static const int32_t COMPRESSED_ENCODING_HEADER_SIZE = 8;
+static const int32_t MAX_ZIG_ZAG_LENGTH              = 9;
+static const int32_t ENCODING_CHUNK_LENGTH           = 512;
+
+struct EncodingHeader
+{
+    int32_t payloadLength;
+    int32_t normalizingIndexOffset;
+    int32_t numberOfSignificantValueDigits;
+    int64_t lowestDiscernibleValue;
+    int64_t highestTrackableValue;
+    double integerToDoubleValueConversionRatio;
+};
+
+static void putInt32(uint8_t* buffer, int32_t value)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        buffer[i] = (uint8_t) (((uint32_t) value) >> (24 - 8 * i));
+    }
+}
+
+static void putInt64(uint8_t* buffer, int64_t value)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        buffer[i] = (uint8_t) (((uint64_t) value) >> (56 - 8 * i));
+    }
+}
+
+static int32_t getInt32(const uint8_t* buffer)
+{
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        value = (value << 8) | buffer[i];
+    }
+    return (int32_t) value;
+}
+
+static int64_t getInt64(const uint8_t* buffer)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++)
+    {
+        value = (value << 8) | buffer[i];
+    }
+    return (int64_t) value;
+}
+
+// Up to eight bytes of seven bits each, then a ninth byte holding the last
+// eight bits, so any int64_t fits in at most nine bytes.
+static int32_t putZigZag(uint8_t* buffer, int64_t signedValue)
+{
+    auto value = (((uint64_t) signedValue) << 1) ^ (uint64_t) (signedValue >> 63);
+    int32_t length = 0;
+    while (length < 8 && value >= 0x80)
+    {
+        buffer[length++] = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    buffer[length++] = (uint8_t) value;
+    return length;
+}
+
+static int32_t zigZagLength(int64_t signedValue)
+{
+    uint8_t buffer[MAX_ZIG_ZAG_LENGTH];
+    return putZigZag(buffer, signedValue);
+}
+
+// Decodes a byte at a time, so a value may straddle inflated chunks.
+struct ZigZagDecoder
+{
+    uint64_t value  = 0;
+    int32_t  length = 0;
+
+    bool put(uint8_t byte, int64_t& decoded)
+    {
+        if (length < 8)
+        {
+            value |= ((uint64_t) (byte & 0x7f)) << (7 * length++);
+            if (byte & 0x80)
+            {
+                return false;
+            }
+        }
+        else
+        {
+            value |= ((uint64_t) byte) << 56;
+        }
+        decoded = ((int64_t) (value >> 1)) ^ -((int64_t) (value & 1));
+        value  = 0;
+        length = 0;
+        return true;
+    }
+};
+
+// Hands emit the encoded counts from index 0 to toIndex: a count as itself,
+// a run of more than one zero as minus its length.  Everything below
+// fromIndex is known to be zero and goes out as a single run.
+template <typename CountType, typename Emit>
+static void forRunLengthCounts(const CountsArray< CountType >& counts, int32_t fromIndex, int32_t toIndex, Emit emit)
+{
+    if (fromIndex > 0)
+    {
+        emit((fromIndex > 1) ? -((int64_t) fromIndex) : 0);
+    }
+
+    for (int32_t i = fromIndex; i < toIndex; )
+    {
+        int64_t count = counts.get(i++);
+        assert(count >= 0);
+        if (0 != count)
+        {
+            emit(count);
+            continue;
+        }
+
+        int64_t zerosCount = 1;
+        while (i < toIndex && 0 == counts.get(i))
+        {
+            zerosCount++;
+            i++;
+        }
+        emit((zerosCount > 1) ? -zerosCount : 0);
+    }
+}
+
+static bool inflateExactly(z_stream& stream, uint8_t* buffer, uint32_t length)
+{
+    stream.next_out  = buffer;
+    stream.avail_out = length;
+    while (0 != stream.avail_out)
+    {
+        int result = inflate(&stream, Z_NO_FLUSH);
+        if ((Z_OK != result && Z_STREAM_END != result) || (Z_STREAM_END == result && 0 != stream.avail_out))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Inflater state carved out of a caller's (stack) buffer, for decoding
+// without touching the heap.  zlib needs its state plus a 32KB window.
+struct InflateArena
+{
+    alignas(16) uint8_t bytes[48 * 1024];
+    size_t used = 0;
+
+    static voidpf allocate(voidpf opaque, uInt items, uInt size)
+    {
+        auto arena  = (InflateArena*) opaque;
+        auto length = (((size_t) items * size) + 15) & ~((size_t) 15);
+        if (arena->used + length > sizeof(arena->bytes))
+        {
+            return Z_NULL;
+        }
+        voidpf allocated = arena->bytes + arena->used;
+        arena->used += length;
+        return allocated;
+    }
+
+    static void release(voidpf, voidpf)
+    {
+    }
+};
+
+// Checks the cookies, starts inflating and reads the header.  On success the
+// stream is left positioned at the payload and must be ended by the caller.
+static bool openCompressedEncoding(const uint8_t* buffer, size_t length, z_stream& stream, EncodingHeader& header,
+                                   InflateArena* arena = nullptr)
+{
+    if (length < (size_t) COMPRESSED_ENCODING_HEADER_SIZE ||
+        (getInt32(buffer) & ~COOKIE_WORD_SIZE_MASK) != (V2_COMPRESSED_ENCODING_COOKIE & ~COOKIE_WORD_SIZE_MASK))
+    {
+        return false;
+    }
+    int32_t compressedLength = getInt32(buffer + 4);
+    if (compressedLength < 0 || (size_t) compressedLength > length - COMPRESSED_ENCODING_HEADER_SIZE)
+    {
+        return false;
+    }
+
+    memset(&stream, 0, sizeof(stream));
+    if (nullptr != arena)
+    {
+        stream.zalloc = InflateArena::allocate;
+        stream.zfree  = InflateArena::release;
+        stream.opaque = arena;
+    }
+    stream.next_in  = (Bytef*) (buffer + COMPRESSED_ENCODING_HEADER_SIZE);
+    stream.avail_in = (uInt) compressedLength;
+    if (Z_OK != inflateInit(&stream))
+    {
+        return false;
+    }
+
+    uint8_t bytes[V2_ENCODING_HEADER_SIZE];
+    if (!inflateExactly(stream, bytes, V2_ENCODING_HEADER_SIZE) ||
+        (getInt32(bytes) & ~COOKIE_WORD_SIZE_MASK) != (V2_ENCODING_COOKIE & ~COOKIE_WORD_SIZE_MASK))
+    {
+        inflateEnd(&stream);
+        return false;
+    }
+
+    header.payloadLength                  = getInt32(bytes + 4);
+    header.normalizingIndexOffset         = getInt32(bytes + 8);
+    header.numberOfSignificantValueDigits = getInt32(bytes + 12);
+    header.lowestDiscernibleValue         = getInt64(bytes + 16);
+    header.highestTrackableValue          = getInt64(bytes + 24);
+    int64_t ratioBits                     = getInt64(bytes + 32);
+    memcpy(&header.integerToDoubleValueConversionRatio, &ratioBits, sizeof(ratioBits));
+
+    // Shifted (normalized) encodings are not produced by integer histograms.
+    if (header.payloadLength < 0 || 0 != header.normalizingIndexOffset ||
+        header.numberOfSignificantValueDigits < 0 || header.numberOfSignificantValueDigits > 5 ||
+        header.highestTrackableValue > (std::numeric_limits< int64_t >::max() >> 1) ||
+        header.lowestDiscernibleValue < 1 || header.highestTrackableValue < 2 * header.lowestDiscernibleValue)
+    {
+        inflateEnd(&stream);
+        return false;
+    }
+    return true;
+}
+
+// Inflates the payload a chunk at a time and hands addCount each non-zero
+// count with its counts index.  Returns false if the payload is truncated,
+// a count or run of zeros runs past countsLimit or addCount refuses a count.
+template <typename AddCount>
+static bool inflateCounts(z_stream& stream, int32_t payloadLength, int32_t countsLimit, AddCount addCount)
+{
+    uint8_t chunk[ENCODING_CHUNK_LENGTH];
+    ZigZagDecoder decoder;
+    int64_t countsIndex = 0;
+
+    for (int32_t remaining = payloadLength; remaining > 0; )
+    {
+        auto chunkLength = (uint32_t) std::min(remaining, ENCODING_CHUNK_LENGTH);
+        if (!inflateExactly(stream, chunk, chunkLength))
+        {
+            return false;
+        }
+        remaining -= chunkLength;
+
+        for (uint32_t i = 0; i < chunkLength; i++)
+        {
+            int64_t count;
+            if (!decoder.put(chunk[i], count))
+            {
+                continue;
+            }
+            if (count < 0)
+            {
+                // A run may not reach past the end of the counts, which also
+                // keeps countsIndex from overflowing.
+                if (std::numeric_limits< int64_t >::min() == count || -count > countsLimit - countsIndex)
+                {
+                    return false;
+                }
+                countsIndex -= count;
+                continue;
+            }
+            if (countsIndex >= countsLimit)
+            {
+                return false;
+            }
+            if (0 != count && !addCount((int32_t) countsIndex, count))
+            {
+                return false;
+            }
+            countsIndex++;
+        }
+    }
+    return 0 == decoder.length;
+}
+
+template <typename CountType>
+void BasicHistogram<CountType>::occupiedCountsRange(int32_t& fromIndex, int32_t& toIndex) const
+{
+    fromIndex = 0;
+    toIndex   = 0;
+    if (trackStatistics)
+    {
+        if (0 != totalCount)
+        {
+            fromIndex = minCountsIndex;
+            toIndex   = maxCountsIndex + 1;
+        }
+        return;
+    }
+
+    for (auto i = occupancy.previousOccupied(countsArrayLength - 1); i >= 0; i = occupancy.previousOccupied(i - 1))
+    {
+        if (0 != counts.get(i))
+        {
+            toIndex = i + 1;
+            break;
+        }
+    }
+    for (auto i = occupancy.nextOccupied(0); i < toIndex; i = occupancy.nextOccupied(i + 1))
+    {
+        if (0 != counts.get(i))
+        {
+            fromIndex = i;
+            break;
+        }
+    }
+}
+
+template <typename CountType>
+size_t BasicHistogram<CountType>::getNeededByteBufferCapacity() const
+{
+    int32_t fromIndex, toIndex;
+    occupiedCountsRange(fromIndex, toIndex);
+    auto payloadBound = (uLong) (toIndex - fromIndex + 1) * MAX_ZIG_ZAG_LENGTH;
+    return COMPRESSED_ENCODING_HEADER_SIZE + compressBound(V2_ENCODING_HEADER_SIZE + payloadBound);
+}
+
+template <typename CountType>
+size_t BasicHistogram<CountType>::encodeIntoCompressedByteBuffer(uint8_t* buffer, size_t capacity) const
+{
+    if (capacity <= (size_t) COMPRESSED_ENCODING_HEADER_SIZE)
+    {
+        return 0;
+    }
+
+    // The header leads with the payload length, so size the payload first.
+    int32_t fromIndex, toIndex;
+    occupiedCountsRange(fromIndex, toIndex);
+    int64_t payloadLength = 0;
+    forRunLengthCounts(counts, fromIndex, toIndex, [&] (int64_t token)
+    {
+        payloadLength += zigZagLength(token);
+    });
+    assert(payloadLength <= std::numeric_limits< int32_t >::max());
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (Z_OK != deflateInit(&stream, Z_DEFAULT_COMPRESSION))
+    {
+        return 0;
+    }
+    stream.next_out  = buffer + COMPRESSED_ENCODING_HEADER_SIZE;
+    stream.avail_out = (uInt) std::min< size_t >(capacity - COMPRESSED_ENCODING_HEADER_SIZE,
+                                                 std::numeric_limits< uInt >::max());
+
+    // The uncompressed encoding is built a chunk at a time on the stack and
+    // deflated straight into the caller's buffer.
+    uint8_t chunk[ENCODING_CHUNK_LENGTH];
+    int32_t chunkLength = V2_ENCODING_HEADER_SIZE;
+    int64_t ratioBits;
+    double ratio = 1.0;
+    memcpy(&ratioBits, &ratio, sizeof(ratioBits));
+    putInt32(chunk, V2_ENCODING_COOKIE);
+    putInt32(chunk + 4, (int32_t) payloadLength);
+    putInt32(chunk + 8, 0);
+    putInt32(chunk + 12, (int32_t) numberOfSignificantValueDigits);
+    putInt64(chunk + 16, lowestDiscernibleValue);
+    putInt64(chunk + 24, highestTrackableValue);
+    putInt64(chunk + 32, ratioBits);
+
+    bool fits = true;
+    auto deflateChunk = [&] (int flush)
+    {
+        stream.next_in  = chunk;
+        stream.avail_in = (uInt) chunkLength;
+        int result = deflate(&stream, flush);
+        fits = fits && ((Z_FINISH == flush) ? (Z_STREAM_END == result) : (0 == stream.avail_in));
+        chunkLength = 0;
+    };
+
+    forRunLengthCounts(counts, fromIndex, toIndex, [&] (int64_t token)
+    {
+        if (chunkLength + MAX_ZIG_ZAG_LENGTH > ENCODING_CHUNK_LENGTH && fits)
+        {
+            deflateChunk(Z_NO_FLUSH);
+        }
+        if (fits)
+        {
+            chunkLength += putZigZag(chunk + chunkLength, token);
+        }
+    });
+    if (fits)
+    {
+        deflateChunk(Z_FINISH);
+    }
+
+    auto compressedLength = (size_t) stream.total_out;
+    deflateEnd(&stream);
+    if (!fits)
+    {
+        return 0;
+    }
+
+    putInt32(buffer, V2_COMPRESSED_ENCODING_COOKIE);
+    putInt32(buffer + 4, (int32_t) compressedLength);
+    return COMPRESSED_ENCODING_HEADER_SIZE + compressedLength;
+}
+
+// The value at a counts index of a histogram with the given layout.
+static int64_t valueFromEncodedCountsIndex(int32_t countsIndex, int32_t unitMagnitude, int32_t subBucketHalfCountMagnitude)
+{
+    int32_t subBucketHalfCount = 1 << subBucketHalfCountMagnitude;
+    auto bucketIndex    = (countsIndex >> subBucketHalfCountMagnitude) - 1;
+    auto subBucketIndex = (countsIndex & (subBucketHalfCount - 1)) + subBucketHalfCount;
+    if (bucketIndex < 0)
+    {
+        subBucketIndex -= subBucketHalfCount;
+        bucketIndex = 0;
+    }
+    return ((int64_t) subBucketIndex) << (bucketIndex + unitMagnitude);
+}
+
+template <typename CountType>
+bool BasicHistogram<CountType>::addEncoded(const uint8_t* data, size_t length)
+{
+    InflateArena arena;
+    z_stream stream;
+    EncodingHeader header;
+    if (!openCompressedEncoding(data, length, stream, header, &arena))
+    {
+        return false;
+    }
+
+    int32_t encodedUnitMagnitude = floorLog2(header.lowestDiscernibleValue);
+    int32_t encodedHalfCountMagnitude = subBucketHalfCountMagnitudeFor(header.numberOfSignificantValueDigits);
+    int32_t encodedSubBucketCount = 2 << encodedHalfCountMagnitude;
+    int32_t encodedCountsArrayLength =
+        (bucketsNeededFor(header.highestTrackableValue, encodedSubBucketCount, encodedUnitMagnitude) + 1) *
+        (encodedSubBucketCount / 2);
+    bool sameLayout = encodedUnitMagnitude == unitMagnitude && encodedHalfCountMagnitude == subBucketHalfCountMagnitude;
+
+    // Counts in our layout go straight to their index; anything else (or
+    // beyond our range, for auto-resize to deal with) is recorded by value.
+    // Without auto-resize a value beyond our range ends the merge.
+    bool complete = inflateCounts(stream, header.payloadLength, encodedCountsArrayLength,
+                                  [&] (int32_t countsIndex, int64_t count)
+    {
+        if (sameLayout && countsIndex < countsArrayLength)
+        {
+            recordCountAtIndex(countsIndex, count);
+            return true;
+        }
+
+        auto value = valueFromEncodedCountsIndex(countsIndex, encodedUnitMagnitude, encodedHalfCountMagnitude);
+        if (!autoResize && getBucketIndex(value) >= bucketCount)
+        {
+            return false;
+        }
+        recordValueWithCount(value, count);
+        return true;
+    });
+    inflateEnd(&stream);
+    return complete;
+}
+
+// Returns null for malformed or truncated input, which arrives from outside
+// and so is not treated as a programming error.
+template <typename CountType>
+std::unique_ptr< BasicHistogram<CountType> >
+BasicHistogram<CountType>::decodeFromCompressedByteBuffer(const uint8_t* buffer, size_t length,
+                                                          int64_t minBarForHighestTrackableValue)
+{
+    z_stream stream;
+    EncodingHeader header;
+    if (!openCompressedEncoding(buffer, length, stream, header))
+    {
+        return nullptr;
+    }
+
+    std::unique_ptr< BasicHistogram > histogram{
+        new BasicHistogram{ header.lowestDiscernibleValue,
+                            std::max(header.highestTrackableValue, minBarForHighestTrackableValue),
+                            header.numberOfSignificantValueDigits } };
+
+    bool complete = inflateCounts(stream, header.payloadLength, histogram->countsArrayLength,
+                                  [&] (int32_t countsIndex, int64_t count)
+    {
+        histogram->counts.add(countsIndex, count);
+        histogram->markOccupied(countsIndex);
+        histogram->totalCount += count;
+        return true;
+    });
+    inflateEnd(&stream);
+    if (!complete)
+    {
+        return nullptr;
+    }
+
+    if (histogram->trackStatistics)
+    {
+        histogram->recomputeStatistics();
+    }
+    return histogram;
+}
+
+template <typename CountType>
+void BasicHistogram<CountType>::addWhileCorrectingForCoordinatedOmission(const BasicHistogram& other,
+                                                                         int64_t expectedInterval)
+{
+    int64_t countToIndex = 0;
+    for (auto i = other.occupancy.nextOccupied(0);
+         i < other.countsArrayLength && countToIndex < other.totalCount;
+         i = other.occupancy.nextOccupied(i + 1))
+    {
+        auto count = other.counts.get(i);
+        if (0 == count)
+        {
+            continue;
+        }
+        countToIndex += count;
+
+        // As elsewhere in HdrHistogram, a recorded bucket stands for its
+        // highest equivalent value when correcting.
+        auto value = other.highestEquivalentValue(other.valueFromCountsIndex(i));
+        recordValueWithCount(value, count);
+        recordMissingValues(value, count, expectedInterval);
+    }
+}
+
+template <typename CountType>
+BasicHistogram<CountType> BasicHistogram<CountType>::copyCorrectedForCoordinatedOmission(int64_t expectedInterval) const
+{
+    BasicHistogram corrected{ lowestDiscernibleValue, highestTrackableValue, numberOfSignificantValueDigits };
+    corrected.addWhileCorrectingForCoordinatedOmission(*this, expectedInterval);
+    return corrected;
+}
+
+template <typename CountType>
+void BasicHistogram<CountType>::recordCountAtIndex(int32_t countsIndex, int64_t count)
+{
+    counts.add(countsIndex, count);
+    markOccupied(countsIndex);
+    totalCount += count;
+
+    if (trackStatistics && 0 != count)
+    {
+        updateStatistics(countsIndex, count);
+    }
+    if (!rankIndex.empty())
+    {
+        addToRankIndex(countsIndex, count);
+    }
+}
+
+// Indices are worked out a batch at a time so the kernel can stay in
+// registers, then the counts are bumped in a separate scatter pass.
+static const size_t RECORD_BATCH_LENGTH = 256;
+
+template <typename CountType>
+void BasicHistogram<CountType>::recordValues(const int64_t* values, size_t length)
+{
+    int32_t indices[RECORD_BATCH_LENGTH];
+
+    for (size_t offset = 0; offset < length; offset += RECORD_BATCH_LENGTH)
+    {
+        auto batchLength = (length - offset < RECORD_BATCH_LENGTH) ? (length - offset) : RECORD_BATCH_LENGTH;
+        countsIndicesFor(values + offset, batchLength, indices);
+        resizeToFitIndices(indices, batchLength);
+
+        for (size_t i = 0; i < batchLength; i++)
+        {
+            assert(indices[i] < countsArrayLength);
+            counts.add(indices[i], 1);
+            markOccupied(indices[i]);
+        }
+
+        if (trackStatistics)
+        {
+            for (size_t i = 0; i < batchLength; i++)
+            {
+                updateStatistics(indices[i], 1);
+            }
+        }
+        if (!rankIndex.empty())
+        {
+            for (size_t i = 0; i < batchLength; i++)
+            {
+                addToRankIndex(indices[i], 1);
+            }
+        }
+    }
+
+    totalCount += length;
+}
+
+template <typename CountType>
+void BasicHistogram<CountType>::recordValuesWithCounts(const int64_t* values, const int64_t* valueCounts, size_t length)
+{
+    int32_t indices[RECORD_BATCH_LENGTH];
+
+    for (size_t offset = 0; offset < length; offset += RECORD_BATCH_LENGTH)
+    {
+        auto batchLength = (length - offset < RECORD_BATCH_LENGTH) ? (length - offset) : RECORD_BATCH_LENGTH;
+        countsIndicesFor(values + offset, batchLength, indices);
+        resizeToFitIndices(indices, batchLength);
+
+        for (size_t i = 0; i < batchLength; i++)
+        {
+            assert(indices[i] < countsArrayLength);
+            recordCountAtIndex(indices[i], valueCounts[offset + i]);
+        }
+    }
+}
+
+// Grows the histogram to fit the largest index of a batch before any of the
+// batch is counted.  Resizing rebuilds the rank index from the counts, so
+// growing part way through would count the batch's earlier values twice.
+template <typename CountType>
+void BasicHistogram<CountType>::resizeToFitIndices(const int32_t* indices, size_t length)
+{
+    int32_t maxIndex = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        maxIndex = (indices[i] > maxIndex) ? indices[i] : maxIndex;
+    }
+    if (maxIndex >= countsArrayLength)
+    {
+        resizeToBucket((maxIndex >> subBucketHalfCountMagnitude) - 1);
+    }
+}
+
+// Only the blocks the occupancy bitmap marks can hold counts, so a histogram
+// that is reset every interval pays for the blocks it used rather than for
+// the whole counts array.
+template <typename CountType>
+void BasicHistogram<CountType>::reset()
+{
+    auto runStart = occupancy.nextOccupied(0);
+    while (runStart < countsArrayLength)
+    {
+        auto runEnd = occupancy.nextUnoccupied(runStart);
+        counts.clear(runStart, runEnd);
+        runStart = occupancy.nextOccupied(runEnd);
+    }
+    occupancy.clear();
+    totalCount = 0;
+    resetStatistics();
+    std::fill(rankIndex.begin(), rankIndex.end(), 0);
+}
+
+/////////////////// Auto Resize /////////////////////
+
+template <typename CountType>
+void BasicHistogram<CountType>::setAutoResize(bool enabled)
+{
+    autoResize = enabled;
+}
+
+template <typename CountType>
+bool BasicHistogram<CountType>::isAutoResize() const
+{
+    return autoResize;
+}
+
+// Adds whole buckets up to and including bucketIndex.  The counts array is
+// laid out bucket after bucket, so every existing index, and with it the
+// tracked statistics, stays valid; only the rank index has to be rebuilt.
+// Without auto-resize the value is left to the range assertions.
+template <typename CountType>
+void BasicHistogram<CountType>::resizeToBucket(int32_t bucketIndex)
+{
+    if (!autoResize || bucketIndex < bucketCount)
+    {
+        return;
+    }
+
+    bucketCount           = bucketIndex + 1;
+    countsArrayLength     = (bucketCount + 1) * subBucketHalfCount;
+    highestTrackableValue = highestEquivalentValue(valueFromIndex(bucketCount - 1, subBucketCount - 1));
+    counts.resize(countsArrayLength);
+    occupancy.resize(countsArrayLength);
+
+    if (!rankIndex.empty())
+    {
+        std::vector< int64_t >().swap(rankIndex);
+        setRankIndexing(true);
+    }
+}
+
+/////////////////// Statistics /////////////////////
+
+template <typename CountType>
+void BasicHistogram<CountType>::setStatisticsTracking(bool enabled)
+{
+    if (enabled && !trackStatistics)
+    {
+        recomputeStatistics();
+    }
+    trackStatistics = enabled;
+}
+
+template <typename CountType>
+bool BasicHistogram<CountType>::isStatisticsTracking() const
+{
+    return trackStatistics;
+}
+
+template <typename CountType>
+void BasicHistogram<CountType>::updateStatistics(int32_t countsIndex, int64_t count)
+{
+    minCountsIndex = (countsIndex < minCountsIndex) ? countsIndex : minCountsIndex;
+    maxCountsIndex = (countsIndex > maxCountsIndex) ? countsIndex : maxCountsIndex;
+
+    auto medianValue = medianValueFromCountsIndex(countsIndex);
+    sumOfValues        += count * medianValue;
+    sumOfValuesSquared += count * ((double) medianValue * medianValue);
+}
+
+template <typename CountType>
+void BasicHistogram<CountType>::resetStatistics()
+{
+    minCountsIndex     = std::numeric_limits< int32_t >::max();
+    maxCountsIndex     = -1;
+    sumOfValues        = 0;
+    sumOfValuesSquared = 0.0;
+}
+
+/////////////////// Rank Index /////////////////////
+
+// rankIndex is a 1-based Fenwick tree over the counts array: entry k holds the
+// sum of the counts in (k - lowbit(k), k], so any prefix sum is the sum of at
+// most log2(countsArrayLength) entries.  It is empty when indexing is off.
+
+template <typename CountType>
+void BasicHistogram<CountType>::setRankIndexing(bool enabled)
+{
+    if (!enabled)
+    {
+        std::vector< int64_t >().swap(rankIndex);
+        return;
+    }
+    if (!rankIndex.empty())
+    {
+        return;
+    }
+
+    // Build in O(n): push each node's sum into its parent.
+    rankIndex.assign(countsArrayLength + 1, 0);
+    for (int32_t k = 1; k <= countsArrayLength; k++)
+    {
+        rankIndex[k] += counts.get(k - 1);
+        auto parent = k + (k & -k);
+        if (parent <= countsArrayLength)
+        {
+            rankIndex[parent] += rankIndex[k];
+        }
+    }
+}
+
+template <typename CountType>
+bool BasicHistogram<CountType>::isRankIndexing() const
+{
+    return !rankIndex.empty();
+}
+
+template <typename CountType>
+void BasicHistogram<CountType>::addToRankIndex(int32_t countsIndex, int64_t count)
+{
+    for (auto k = countsIndex + 1; k <= countsArrayLength; k += (k & -k))
+    {
+        rankIndex[k] += count;
+    }
+}
+
+template <typename CountType>
+int64_t BasicHistogram<CountType>::countAtOrBelowIndex(int32_t countsIndex) const
+{
+    int64_t count = 0;
+    for (auto k = countsIndex + 1; k > 0; k -= (k & -k))
+    {
+        count += rankIndex[k];
+    }
+    return count;
+}
+
+// Smallest counts index whose cumulative count reaches the given count, or
+// countsArrayLength if there is none.  Walks down the tree one bit at a time.
+template <typename CountType>
+int32_t BasicHistogram<CountType>::indexForCountAtOrBelow(int64_t count) const
+{
+    int32_t position = 0;
+    int32_t step = 1;
+    while ((step << 1) <= countsArrayLength)
+    {
+        step <<= 1;
+    }
+
+    for (; step > 0; step >>= 1)
+    {
+        if (position + step <= countsArrayLength && rankIndex[position + step] < count)
+        {
+            position += step;
+            count -= rankIndex[position];
+        }
+    }
+
+    return position;
+}
+
+template <typename CountType>
+void BasicHistogram<CountType>::recomputeStatistics()
+{
+    resetStatistics();
+    for (auto i = occupancy.nextOccupied(0); i < countsArrayLength; i = occupancy.nextOccupied(i + 1))
+    {
+        auto count = counts.get(i);
+        if (0 != count)
+        {
+            updateStatistics(i, count);
+        }
+    }
+}
+
+template <typename CountType>
+int32_t BasicHistogram<CountType>::getBucketIndex(int64_t value) const
+{
+    auto pow2ceiling = 64 - __lzcnt64(value | subBucketMask); // smallest power of 2 containing value
+    return pow2ceiling - unitMagnitude - (subBucketHalfCountMagnitude + 1);
+}
+
+template <typename CountType>
+void BasicHistogram<CountType>::incrementCountAtIndex(int32_t countsIndex)
+{
+    counts.add(countsIndex, 1);
+    markOccupied(countsIndex);
+}
+
+// Resolved at compile time: only counts that several threads record into pay
+// for an atomic or.
+template <typename CountType>
+void BasicHistogram<CountType>::markOccupied(int32_t countsIndex)
+{
+    if (CountsTraits< CountType >::recordsConcurrently)
+    {
+        occupancy.markConcurrently(countsIndex);
+    }
+    else
+    {
+        occupancy.mark(countsIndex);
+    }
+}
+
+template <typename CountType>
+void BasicHistogram<CountType>::incrementTotalCount()
+{
+    totalCount += 1;
+}
+
+/////////////////// Utility /////////////////////
+
+template <typename CountType>
+bool BasicHistogram<CountType>::valuesAreEquivalent(int64_t a, int64_t b) const
+{
+    return lowestEquivalentValue(a) == lowestEquivalentValue(b);
+}
+
+template <typename CountType>
+int64_t BasicHistogram<CountType>::lowestEquivalentValue(int64_t value) const
+{
+    auto bucketIndex    = getBucketIndex(value);
+    auto subBucketIndex = getSubBucketIndex(value, bucketIndex);
+
+    return valueFromIndex(bucketIndex, subBucketIndex);
+}
+
+template <typename CountType>
+int64_t BasicHistogram<CountType>::medianEquivalentValue(int64_t value) const
+{
+    return lowestEquivalentValue(value) + (sizeOfEquivalentRange(value) >> 1);
+}
+
+template <typename CountType>
+int64_t BasicHistogram<CountType>::highestEquivalentValue(int64_t value) const
+{
+    return nextNonEquivalentValue(value) - 1;
+}
+
+template <typename CountType>
+int64_t BasicHistogram<CountType>::nextNonEquivalentValue(int64_t value) const
+{
+    return lowestEquivalentValue(value) + sizeOfEquivalentRange(value);
+}
+
+template <typename CountType>
+int64_t BasicHistogram<CountType>::sizeOfEquivalentRange(int64_t value) const
+{
+    auto bucketIndex    = getBucketIndex(value);
+    auto subBucketIndex = getSubBucketIndex(value, bucketIndex);
+    int64_t distanceToNextValue = ((int64_t) 1) << (unitMagnitude + ((subBucketIndex >= subBucketCount) ? (bucketIndex + 1) : bucketIndex));
+    return distanceToNextValue;
+}
+
+template <typename CountType>
+void BasicHistogram<CountType>::print(std::ostream& stream) const
+{
+    stream << "identityCount: "                  << identityCount <<
+            ", lowestDiscernibleValue: "         << lowestDiscernibleValue <<
+            ", highestTrackableValue: "          << highestTrackableValue <<
+            ", numberOfSignificantValueDigits: " << numberOfSignificantValueDigits <<
+            ", unitMagnitude: "                  << unitMagnitude <<
+            ", subBucketHalfCountMagnitude: "    << subBucketHalfCountMagnitude <<
+            ", subBucketHalfCount: "             << subBucketHalfCount <<
+            ", subBucketMask: "                  << subBucketMask <<
+            ", subBucketCount: "                 << subBucketCount <<
+            ", bucketCount: "                    << bucketCount <<
+            ", countsArrayLength: "              << countsArrayLength;
+}
+
+template <typename CountType>
+std::ostream& operator<< (std::ostream& stream, const BasicHistogram<CountType>& histogram)
+{
+    histogram.print(stream);
     return stream;
-}
\ No newline at end of file
+}
+
+template class BasicHistogram< int64_t >;
+template class BasicHistogram< int32_t >;
+template class BasicHistogram< int16_t >;
+template class BasicHistogram< AutoPromotingCount >;
+template class BasicHistogram< PackedCount >;
+template class BasicHistogram< AtomicCount >;
+
+template std::ostream& operator<< (std::ostream&, const BasicHistogram< int64_t >&);
+template std::ostream& operator<< (std::ostream&, const BasicHistogram< int32_t >&);
+template std::ostream& operator<< (std::ostream&, const BasicHistogram< int16_t >&);
+template std::ostream& operator<< (std::ostream&, const BasicHistogram< AutoPromotingCount >&);
+template std::ostream& operator<< (std::ostream&, const BasicHistogram< PackedCount >&);
+template std::ostream& operator<< (std::ostream&, const BasicHistogram< AtomicCount >&);
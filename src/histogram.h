@@ -1,20 +1,525 @@
 
 // Required includes
 // #include <stdint.h>
+// #include <math.h>
 // #include <iostream>
+// #include <memory>
 // #include <vector>
+// #include <limits>
+// #include <algorithm>
+// #include <functional>
+// #include <iterator>
+// #include <assert.h>
 
-class Histogram final
+// Counts storage.  A histogram's counts are kept in a CountsArray of its
+// CountType, so narrower counts shrink the array (and the cache footprint of
+// every scan) at the cost of a lower per-value limit.  A fixed width counter
+// that overflows wraps; this is only checked in debug builds.
+template <typename CountType>
+class CountsArray final
 {
 
 public:
 
+    int64_t get(int32_t index) const
+    {
+        return counts[index];
+    }
+
+    void add(int32_t index, int64_t count)
+    {
+        assert(counts[index] + count <= std::numeric_limits< CountType >::max());
+        assert(counts[index] + count >= std::numeric_limits< CountType >::min());
+        counts[index] = (CountType) (counts[index] + count);
+    }
+
+    void resize(int32_t length)
+    {
+        counts.resize(length);
+    }
+
+    void clear()
+    {
+        std::fill(counts.begin(), counts.end(), 0);
+    }
+
+    // Zeroes the counts from fromIndex up to toIndex.
+    void clear(int32_t fromIndex, int32_t toIndex)
+    {
+        std::fill(counts.begin() + fromIndex, counts.begin() + toIndex, 0);
+    }
+
+    int32_t size() const
+    {
+        return (int32_t) counts.size();
+    }
+
+    int32_t wordSize() const
+    {
+        return sizeof(CountType);
+    }
+
+    size_t footprintInBytes() const
+    {
+        return counts.capacity() * sizeof(CountType);
+    }
+
+    CountType* data()
+    {
+        return counts.data();
+    }
+
+    const CountType* data() const
+    {
+        return counts.data();
+    }
+
+private:
+    std::vector< CountType > counts;
+
+};
+
+// Tag for histograms whose counts start at 16 bits and are widened, first to
+// 32 then to 64 bits, the first time any single counter would overflow.
+struct AutoPromotingCount
+{
+};
+
+template <>
+class CountsArray< AutoPromotingCount > final
+{
+
+public:
+
+    CountsArray() : counts16{}, counts32{}, counts64{}, width{ 2 }
+    {
+    }
+
+    int64_t get(int32_t index) const
+    {
+        switch (width)
+        {
+            case 2:  return counts16[index];
+            case 4:  return counts32[index];
+            default: return counts64[index];
+        }
+    }
+
+    void add(int32_t index, int64_t count)
+    {
+        int64_t sum;
+        switch (width)
+        {
+            case 2:
+                sum = counts16[index] + count;
+                if (sum == (int16_t) sum)
+                {
+                    counts16[index] = (int16_t) sum;
+                    return;
+                }
+                break;
+            case 4:
+                sum = counts32[index] + count;
+                if (sum == (int32_t) sum)
+                {
+                    counts32[index] = (int32_t) sum;
+                    return;
+                }
+                break;
+            default:
+                counts64[index] += count;
+                return;
+        }
+
+        promote();
+        add(index, count);
+    }
+
+    void resize(int32_t length)
+    {
+        switch (width)
+        {
+            case 2:  counts16.resize(length); break;
+            case 4:  counts32.resize(length); break;
+            default: counts64.resize(length); break;
+        }
+    }
+
+    void clear()
+    {
+        std::fill(counts16.begin(), counts16.end(), 0);
+        std::fill(counts32.begin(), counts32.end(), 0);
+        std::fill(counts64.begin(), counts64.end(), 0);
+    }
+
+    void clear(int32_t fromIndex, int32_t toIndex)
+    {
+        switch (width)
+        {
+            case 2:  std::fill(counts16.begin() + fromIndex, counts16.begin() + toIndex, 0); break;
+            case 4:  std::fill(counts32.begin() + fromIndex, counts32.begin() + toIndex, 0); break;
+            default: std::fill(counts64.begin() + fromIndex, counts64.begin() + toIndex, 0); break;
+        }
+    }
+
+    int32_t size() const
+    {
+        switch (width)
+        {
+            case 2:  return (int32_t) counts16.size();
+            case 4:  return (int32_t) counts32.size();
+            default: return (int32_t) counts64.size();
+        }
+    }
+
+    int32_t wordSize() const
+    {
+        return width;
+    }
+
+    size_t footprintInBytes() const
+    {
+        return counts16.capacity() * sizeof(int16_t) +
+               counts32.capacity() * sizeof(int32_t) +
+               counts64.capacity() * sizeof(int64_t);
+    }
+
+private:
+    std::vector< int16_t > counts16;
+    std::vector< int32_t > counts32;
+    std::vector< int64_t > counts64;
+    int32_t width;
+
+    // Only one of the vectors is in use at a time; promoting copies it into
+    // the next wider one and releases the old storage.
+    void promote()
+    {
+        if (2 == width)
+        {
+            counts32.assign(counts16.begin(), counts16.end());
+            std::vector< int16_t >().swap(counts16);
+            width = 4;
+        }
+        else
+        {
+            counts64.assign(counts32.begin(), counts32.end());
+            std::vector< int32_t >().swap(counts32);
+            width = 8;
+        }
+    }
+
+};
+
+// Tag for histograms whose counts are stored sparsely.  The counts array is
+// split into fixed size pages and only pages holding a non-zero count are
+// allocated, so memory follows the number of occupied buckets rather than the
+// configured range and precision.  Lookups cost one extra indirection.
+struct PackedCount
+{
+};
+
+template <>
+class CountsArray< PackedCount > final
+{
+
+public:
+
+    CountsArray() : pages{}, pageStorage{}, length{ 0 }
+    {
+    }
+
+    int64_t get(int32_t index) const
+    {
+        auto page = pages[index >> PAGE_MAGNITUDE];
+        return (0 == page) ? 0 : pageStorage[((page - 1) << PAGE_MAGNITUDE) + (index & PAGE_MASK)];
+    }
+
+    void add(int32_t index, int64_t count)
+    {
+        if (0 == count)
+        {
+            return;
+        }
+
+        auto& page = pages[index >> PAGE_MAGNITUDE];
+        if (0 == page)
+        {
+            pageStorage.resize(pageStorage.size() + PAGE_LENGTH);
+            page = (uint32_t) (pageStorage.size() >> PAGE_MAGNITUDE);
+        }
+        pageStorage[((page - 1) << PAGE_MAGNITUDE) + (index & PAGE_MASK)] += count;
+    }
+
+    void resize(int32_t newLength)
+    {
+        length = newLength;
+        pages.resize((newLength + PAGE_MASK) >> PAGE_MAGNITUDE);
+    }
+
+    // Keeps the page storage allocated, so a histogram that is reset every
+    // interval does not reallocate.
+    void clear()
+    {
+        std::fill(pages.begin(), pages.end(), 0);
+        pageStorage.clear();
+    }
+
+    // Leaves the pages in the range allocated, zeroing them in place.
+    void clear(int32_t fromIndex, int32_t toIndex)
+    {
+        for (int32_t i = fromIndex; i < toIndex; i++)
+        {
+            auto page = pages[i >> PAGE_MAGNITUDE];
+            if (0 != page)
+            {
+                pageStorage[((page - 1) << PAGE_MAGNITUDE) + (i & PAGE_MASK)] = 0;
+            }
+        }
+    }
+
+    int32_t size() const
+    {
+        return length;
+    }
+
+    int32_t wordSize() const
+    {
+        return sizeof(int64_t);
+    }
+
+    size_t footprintInBytes() const
+    {
+        return pages.capacity() * sizeof(uint32_t) + pageStorage.capacity() * sizeof(int64_t);
+    }
+
+private:
+    static const int32_t PAGE_MAGNITUDE = 6;
+    static const int32_t PAGE_LENGTH = 1 << PAGE_MAGNITUDE;
+    static const int32_t PAGE_MASK = PAGE_LENGTH - 1;
+
+    // One entry per page: 0 when the page is empty, otherwise one more than
+    // the page's position in pageStorage.
+    std::vector< uint32_t > pages;
+    std::vector< int64_t > pageStorage;
+    int32_t length;
+
+};
+
+// One bit per block of BLOCK_LENGTH counts, set whenever a count in the block
+// is recorded to and cleared only by reset.  A set bit may cover a block that
+// has since gone back to zero, but a clear bit never covers a count, so scans
+// can step over empty stretches of the counts array a word (4096 counts) at a
+// time with tzcnt and lzcnt.  The words are read and cleared with relaxed
+// atomic loads and stores, plain moves on x86, so that a bitmap can be read
+// while markConcurrently is marking it.
+class OccupancyBitmap final
+{
+
+public:
+
+    static const int32_t BLOCK_MAGNITUDE = 6;
+    static const int32_t BLOCK_LENGTH = 1 << BLOCK_MAGNITUDE;
+
+    OccupancyBitmap() : words{}, length{ 0 }
+    {
+    }
+
+    void mark(int32_t index)
+    {
+        auto block = index >> BLOCK_MAGNITUDE;
+        words[block >> WORD_MAGNITUDE] |= ((uint64_t) 1) << (block & WORD_MASK);
+    }
+
+    // mark, for bitmaps that several threads mark at once.  A block is only
+    // written the first time it is marked, so recording into a marked block
+    // costs a load and leaves the word's cache line shared.
+    void markConcurrently(int32_t index)
+    {
+        auto block = index >> BLOCK_MAGNITUDE;
+        auto& word = words[block >> WORD_MAGNITUDE];
+        auto bit   = ((uint64_t) 1) << (block & WORD_MASK);
+        if (0 == (load(word) & bit))
+        {
+            __atomic_fetch_or(&word, bit, __ATOMIC_RELAXED);
+        }
+    }
+
+    // Marks every block marked in other, which must not be longer.
+    void merge(const OccupancyBitmap& other)
+    {
+        assert(other.words.size() <= words.size());
+        for (size_t i = 0; i < other.words.size(); i++)
+        {
+            words[i] |= load(other.words[i]);
+        }
+    }
+
+    // The first index at or after index that lies in a marked block, or the
+    // length if there is none.
+    int32_t nextOccupied(int32_t index) const
+    {
+        if (index >= length)
+        {
+            return length;
+        }
+
+        auto block = index >> BLOCK_MAGNITUDE;
+        auto word  = block >> WORD_MAGNITUDE;
+        auto bits  = load(words[word]) & (~((uint64_t) 0) << (block & WORD_MASK));
+        while (0 == bits)
+        {
+            if (++word == (int32_t) words.size())
+            {
+                return length;
+            }
+            bits = load(words[word]);
+        }
+
+        auto occupiedIndex = ((word << WORD_MAGNITUDE) + __builtin_ctzll(bits)) << BLOCK_MAGNITUDE;
+        return (occupiedIndex > index) ? occupiedIndex : index;
+    }
+
+    // The first index at or after index that lies in an unmarked block, or the
+    // length if there is none: with nextOccupied, the end of a run of marked
+    // blocks.
+    int32_t nextUnoccupied(int32_t index) const
+    {
+        if (index >= length)
+        {
+            return length;
+        }
+
+        auto block = index >> BLOCK_MAGNITUDE;
+        auto word  = block >> WORD_MAGNITUDE;
+        auto bits  = ~load(words[word]) & (~((uint64_t) 0) << (block & WORD_MASK));
+        while (0 == bits)
+        {
+            if (++word == (int32_t) words.size())
+            {
+                return length;
+            }
+            bits = ~load(words[word]);
+        }
+
+        auto unoccupiedIndex = ((word << WORD_MAGNITUDE) + __builtin_ctzll(bits)) << BLOCK_MAGNITUDE;
+        unoccupiedIndex = (unoccupiedIndex > index) ? unoccupiedIndex : index;
+        return (unoccupiedIndex < length) ? unoccupiedIndex : length;
+    }
+
+    // The last index at or before index that lies in a marked block, or -1 if
+    // there is none.
+    int32_t previousOccupied(int32_t index) const
+    {
+        assert(index < length);
+        if (index < 0)
+        {
+            return -1;
+        }
+
+        auto block = index >> BLOCK_MAGNITUDE;
+        auto word  = block >> WORD_MAGNITUDE;
+        auto bits  = load(words[word]) & (~((uint64_t) 0) >> (WORD_MASK - (block & WORD_MASK)));
+        while (0 == bits)
+        {
+            if (--word < 0)
+            {
+                return -1;
+            }
+            bits = load(words[word]);
+        }
+
+        auto occupiedIndex = (((word << WORD_MAGNITUDE) + WORD_MASK - __builtin_clzll(bits) + 1) << BLOCK_MAGNITUDE) - 1;
+        return (occupiedIndex < index) ? occupiedIndex : index;
+    }
+
+    void resize(int32_t newLength)
+    {
+        length = newLength;
+        words.resize((((newLength + BLOCK_LENGTH - 1) >> BLOCK_MAGNITUDE) + WORD_MASK) >> WORD_MAGNITUDE);
+    }
+
+    void clear()
+    {
+        for (auto& word : words)
+        {
+            __atomic_store_n(&word, 0, __ATOMIC_RELAXED);
+        }
+    }
+
+    size_t footprintInBytes() const
+    {
+        return words.capacity() * sizeof(uint64_t);
+    }
+
+private:
+    static const int32_t WORD_MAGNITUDE = 6;
+    static const int32_t WORD_MASK = (1 << WORD_MAGNITUDE) - 1;
+
+    static uint64_t load(const uint64_t& word)
+    {
+        return __atomic_load_n(&word, __ATOMIC_RELAXED);
+    }
+
+    std::vector< uint64_t > words;
+    int32_t length;
+
+};
+
+// The figures a report usually wants alongside its percentiles, gathered in
+// the same pass over the counts by getPercentileSummary.
+struct HistogramSummary
+{
+    int64_t totalCount;
+    int64_t minValue;
+    int64_t maxValue;
+    double meanValue;
+};
+
+// What a histogram keeps besides its counts that depends on the CountType:
+// the type of its total count, whether it starts out tracking statistics and
+// whether several threads may mark its occupancy bitmap at once.  Specialised,
+// like CountsArray, for counts that several threads record into.
+template <typename CountType>
+struct CountsTraits
+{
+    typedef int64_t TotalCount;
+    static const bool tracksStatistics = true;
+    static const bool recordsConcurrently = false;
+};
+
+template <typename CountType, typename Policy>
+class HistogramIterator;
+template <typename CountType, typename Policy>
+class HistogramIterationRange;
+struct AllValuesIteration;
+struct RecordedValuesIteration;
+struct LinearIteration;
+struct LogarithmicIteration;
+struct PercentileIteration;
+
+template <typename CountType>
+class BasicHistogram final
+{
+
+public:
+
+    // One step of an iteration: the values from valueIteratedFrom
+    // (exclusive) to valueIteratedTo (inclusive) and their counts.
     class HistogramValue final
     {
-        friend class Histogram;
+        friend class BasicHistogram;
+        template <typename C, typename P> friend class HistogramIterator;
     public:
         HistogramValue();
         ~HistogramValue();
+        int64_t getValueIteratedTo() const { return valueIteratedTo; }
+        int64_t getValueIteratedFrom() const { return valueIteratedFrom; }
+        int64_t getCountAtValueIteratedTo() const { return countAtValueIteratedTo; }
+        int64_t getCountAddedInThisIterationStep() const { return countAddedInThisIterationStep; }
+        int64_t getTotalCountToThisValue() const { return totalCountToThisValue; }
+        int64_t getTotalValueToThisValue() const { return totalValueToThisValue; }
+        double getPercentile() const { return percentile; }
+        double getPercentileLevelIteratedTo() const { return percentileLevelIteratedTo; }
     private:
         int64_t valueIteratedTo;
         int64_t valueIteratedFrom;
@@ -26,64 +531,685 @@ public:
         double percentileLevelIteratedTo;
     };
 
-    Histogram(int64_t highestTrackableValue,
-              int64_t numberOfSignificantValueDigits);
-    ~Histogram();
+    BasicHistogram(int64_t highestTrackableValue,
+                   int64_t numberOfSignificantValueDigits);
+    // Values closer together than lowestDiscernibleValue are not told apart,
+    // which lets e.g. nanosecond timestamps be kept at microsecond precision
+    // with a much smaller counts array.
+    BasicHistogram(int64_t lowestDiscernibleValue,
+                   int64_t highestTrackableValue,
+                   int64_t numberOfSignificantValueDigits);
+    BasicHistogram(const BasicHistogram& other) = default;
+    BasicHistogram(BasicHistogram&& other) = default;
+    BasicHistogram& operator=(const BasicHistogram& other) = default;
+    BasicHistogram& operator=(BasicHistogram&& other) = default;
+    ~BasicHistogram();
 
+    int64_t getLowestDiscernibleValue() const;
     int64_t getHighestTrackableValue() const;
     int64_t getNumberOfSignificantValueDigits() const;
     int64_t getTotalCount() const;
+    int32_t getCountsWordSize() const;
+    size_t getEstimatedFootprintInBytes() const;
     int64_t getCountAtValue(int64_t value) const;
 
+    // Visits the counts in value order up to the last one recorded, passing
+    // over runs of zeros that the occupancy bitmap shows were never recorded.
     void forAll(std::function<void (const int64_t value, const int64_t count)> func) const;
     void forPercentiles(const int32_t tickPerHalfDistance,
                         std::function<void (const double percentileTo,
                                             const int64_t value,
                                             const int64_t count)> func) const;
+
+    // Visitor overloads of the above, taking any callable so that it can be
+    // inlined into the scan rather than called through std::function.
+    template <typename Visitor>
+    void forAll(Visitor visitor) const;
+    template <typename Visitor>
+    void forPercentiles(const int32_t tickPerHalfDistance, Visitor visitor) const;
+
+    // Iterator ranges, for use with range-based for, following the Java
+    // iterators of the same names.
+    HistogramIterationRange< CountType, AllValuesIteration > allValues() const;
+    HistogramIterationRange< CountType, RecordedValuesIteration > recordedValues() const;
+    HistogramIterationRange< CountType, LinearIteration > linearBucketValues(int64_t valueUnitsPerBucket) const;
+    HistogramIterationRange< CountType, LogarithmicIteration > logarithmicBucketValues(int64_t valueUnitsInFirstBucket,
+                                                                                      double logBase) const;
+    HistogramIterationRange< CountType, PercentileIteration > percentiles(int32_t percentileTicksPerHalfDistance) const;
     void outputPercentileValues(std::ostream& out, int tickPerHalfDistance, double unitScalingValue);
 
     int64_t getMaxValue() const;
     int64_t getMinValue() const;
     double getMeanValue() const;
+    double getStdDeviation() const;
     int64_t lowestEquivalentValue(int64_t value) const;
     int64_t medianEquivalentValue(int64_t value) const;
     int64_t highestEquivalentValue(int64_t value) const;
     int64_t sizeOfEquivalentRange(int64_t value) const;
     int64_t nextNonEquivalentValue(int64_t value) const;
     int64_t getValueAtPercentile(double percentile) const;
+    void getValuesAtPercentiles(const double* percentiles, size_t length, int64_t* values) const;
+    void getPercentileSummary(const double* percentiles, size_t length, int64_t* values,
+                              HistogramSummary& summary) const;
     double getPercentileAtOrBelowValue(int64_t value) const;
     int64_t getCountBetweenValues(int64_t lo, int64_t hi) const;
 
     void recordValue(int64_t value);
     void recordValue(int64_t value, int64_t expectedInterval);
+    void recordValueWithCount(int64_t value, int64_t count);
+    // Only for histograms recorded to by one thread at a time, though others
+    // may read them: atomic counts take a plain load and store instead of a
+    // locked add.  Other counts record as recordValue.
+    void recordValueSingleWriter(int64_t value);
+    void recordValues(const int64_t* values, size_t length);
+    void recordValuesWithCounts(const int64_t* values, const int64_t* valueCounts, size_t length);
+    void reset();
+
+    // Adds (or takes away) every count in other.  Histograms with the same
+    // bucket layout are combined element-wise over the counts array, others
+    // by re-recording each of other's non-zero buckets.  Returns false,
+    // changing nothing, if other holds values beyond this histogram's range
+    // and it does not auto-resize, or when subtracting, if any of other's
+    // counts is more than this histogram holds at that value.
+    bool add(const BasicHistogram& other);
+    bool subtract(const BasicHistogram& other);
+
+    // The V2 compressed encoding shared with the Java and C implementations:
+    // a header and ZigZag LEB128 run-length encoded counts, DEFLATE wrapped.
+    // Encoding writes into the caller's buffer and returns the number of
+    // bytes written, or 0 if capacity is too small.  Decoding returns null if
+    // the encoding is malformed or truncated.
+    size_t getNeededByteBufferCapacity() const;
+    size_t encodeIntoCompressedByteBuffer(uint8_t* buffer, size_t capacity) const;
+    static std::unique_ptr< BasicHistogram > decodeFromCompressedByteBuffer(const uint8_t* buffer, size_t length,
+                                                                          int64_t minBarForHighestTrackableValue = 0);
+
+    // Adds the counts of a V2 compressed encoding without decoding it into a
+    // histogram first, inflating a chunk at a time on the stack.  Returns
+    // false for malformed input, or a value beyond the range of a histogram
+    // that does not auto-resize, leaving any counts decoded before the fault
+    // added.
+    bool addEncoded(const uint8_t* data, size_t length);
+
+    // Post-hoc coordinated omission correction: adds other's values, plus the
+    // values recordValue(value, expectedInterval) would have filled in for
+    // each of them, working a sub-bucket at a time.
+    void addWhileCorrectingForCoordinatedOmission(const BasicHistogram& other, int64_t expectedInterval);
+    BasicHistogram copyCorrectedForCoordinatedOmission(int64_t expectedInterval) const;
+
+    // Lets values above highestTrackableValue grow the histogram by whole
+    // buckets instead of overrunning the counts array.
+    void setAutoResize(bool enabled);
+    bool isAutoResize() const;
+
+    // Min, max, mean and standard deviation are kept up to date as values
+    // are recorded, making their accessors O(1).  Recorders on the hottest
+    // paths can turn this off, in which case the accessors scan the counts.
+    void setStatisticsTracking(bool enabled);
+    bool isStatisticsTracking() const;
+
+    // Keeps a Fenwick tree of the counts alongside them, so that percentile,
+    // rank and range queries take O(log n) rather than scanning the counts,
+    // at the cost of an O(log n) update on every record.
+    void setRankIndexing(bool enabled);
+    bool isRankIndexing() const;
 
     void print( std::ostream& stream ) const;
     bool valuesAreEquivalent(int64_t a, int64_t b) const;
 
 private:
     int64_t identityCount;
+    int64_t lowestDiscernibleValue;
     int64_t highestTrackableValue;
     int64_t numberOfSignificantValueDigits;
+    int32_t unitMagnitude;
     int32_t subBucketHalfCountMagnitude;
     int32_t subBucketHalfCount;
     int64_t subBucketMask;
     int32_t subBucketCount;
     int32_t bucketCount;
     int32_t countsArrayLength;
-    int64_t totalCount;
-    std::vector< int64_t > counts;
+    typename CountsTraits< CountType >::TotalCount totalCount;
+    CountsArray< CountType > counts;
+    OccupancyBitmap occupancy;
+
+    bool autoResize;
+    bool trackStatistics;
+    int32_t minCountsIndex;
+    int32_t maxCountsIndex;
+    int64_t sumOfValues;
+    double sumOfValuesSquared;
+
+    std::vector< int64_t > rankIndex;
 
     void init();
 
     int32_t getBucketIndex(int64_t value) const;
     int32_t getSubBucketIndex(int64_t value, int32_t bucketIndex) const;
+    int64_t valueFromIndex(int32_t bucketIndex, int32_t subBucketIndex) const;
     int32_t countsArrayIndex(int32_t bucketIndex, int32_t subBucketIndex) const;
     int32_t countsIndexFor(int64_t value) const;
-    int64_t getCountAtIndex(int32_t bucketIndex, int32_t subBucketIndex) const;
+    int32_t countsIndexForRecording(int64_t value);
+    void resizeToBucket(int32_t bucketIndex);
+    void resizeToFitIndices(const int32_t* indices, size_t length);
+
+    void countsIndicesFor(const int64_t* values, size_t length, int32_t* indices) const;
+
+    int64_t valueFromCountsIndex(int32_t countsIndex) const;
+    int64_t medianValueFromCountsIndex(int32_t countsIndex) const;
+    void updateStatistics(int32_t countsIndex, int64_t count);
+    void resetStatistics();
+    void recomputeStatistics();
+
+    void addToRankIndex(int32_t countsIndex, int64_t count);
+    int64_t countAtOrBelowIndex(int32_t countsIndex) const;
+    int32_t indexForCountAtOrBelow(int64_t count) const;
+
+    int64_t countAtPercentile(double percentile) const;
+    int64_t countBetweenIndices(int32_t fromIndex, int32_t toIndex) const;
+    void sweepPercentiles(const double* percentiles, size_t length, int64_t* values,
+                          HistogramSummary* summary) const;
 
+    void recordCountAtIndex(int32_t countsIndex, int64_t count);
+    bool addCounts(const BasicHistogram& other, int64_t sign);
+    bool hasSameLayoutAs(const BasicHistogram& other) const;
+    void mergeStatistics(const BasicHistogram& other);
+    void rebuildRankIndex();
+    void occupiedCountsRange(int32_t& fromIndex, int32_t& toIndex) const;
+    void recordMissingValues(int64_t value, int64_t count, int64_t expectedInterval);
     void incrementCountAtIndex(int32_t countsIndex);
+    void markOccupied(int32_t countsIndex);
     void incrementTotalCount();
 
+    template <typename C, typename P> friend class HistogramIterator;
+
+    friend bool mergeAll(const BasicHistogram< int64_t >* const* histograms, size_t length,
+                         BasicHistogram< int64_t >& out, unsigned threads);
+
+};
+
+typedef BasicHistogram< int64_t > Histogram;
+typedef BasicHistogram< int32_t > IntCountsHistogram;
+typedef BasicHistogram< int16_t > ShortCountsHistogram;
+typedef BasicHistogram< AutoPromotingCount > AutoPromotingHistogram;
+typedef BasicHistogram< PackedCount > PackedHistogram;
+
+// Adds every one of histograms into out, splitting out's counts array into
+// cache line aligned ranges that are summed by up to threads workers.  Merges
+// too small to repay starting a thread run on the calling thread.  Inputs
+// whose layout differs from out's are added one at a time beforehand.  Returns
+// false if any input held values beyond out's range; those are left out.
+bool mergeAll(const Histogram* const* histograms, size_t length, Histogram& out, unsigned threads);
+
+template <typename CountType>
+std::ostream& operator<< (std::ostream& stream, const BasicHistogram< CountType >& histogram);
+
+/////////////////// Iteration /////////////////////
+
+// On every step of a scan, so defined here where they can be inlined.
+template <typename CountType>
+int64_t BasicHistogram<CountType>::valueFromIndex(int32_t bucketIndex, int32_t subBucketIndex) const
+{
+    return ((int64_t) subBucketIndex) << (bucketIndex + unitMagnitude);
+}
+
+// Inverse of countsArrayIndex.  The first half of bucket 0 has no bucket of
+// its own in the counts array, it sits in the slots below bucket 0's base.
+template <typename CountType>
+int64_t BasicHistogram<CountType>::valueFromCountsIndex(int32_t countsIndex) const
+{
+    auto bucketIndex    = (countsIndex >> subBucketHalfCountMagnitude) - 1;
+    auto subBucketIndex = (countsIndex & (subBucketHalfCount - 1)) + subBucketHalfCount;
+    if (bucketIndex < 0)
+    {
+        subBucketIndex -= subBucketHalfCount;
+        bucketIndex = 0;
+    }
+    return valueFromIndex(bucketIndex, subBucketIndex);
+}
+
+template <typename CountType>
+int64_t BasicHistogram<CountType>::medianValueFromCountsIndex(int32_t countsIndex) const
+{
+    auto bucketIndex = (countsIndex >> subBucketHalfCountMagnitude) - 1;
+    bucketIndex = (bucketIndex < 0) ? 0 : bucketIndex;
+    return valueFromCountsIndex(countsIndex) + ((((int64_t) 1) << (bucketIndex + unitMagnitude)) >> 1);
+}
+
+// The iterators share one walk over the counts array, as in the Java
+// AbstractHistogramIterator; a policy decides where each step ends and what
+// value it reports.  The walk and the policy are both templates, so a range-
+// based for over them compiles down to a loop over the counts.
+template <typename CountType>
+struct HistogramIterationState
+{
+    const BasicHistogram< CountType >* histogram;
+    int32_t countsArrayLength;
+    int64_t totalCount;
+    int32_t currentIndex;
+    int64_t currentValueAtIndex;
+    int64_t nextValueAtIndex;
+    int64_t countAtThisValue;
+    int64_t totalCountToCurrentIndex;
+    int64_t totalValueToCurrentIndex;
+};
+
+// Policies that only stop at non-zero counts let the walk step over blocks
+// the occupancy bitmap marks as empty.
+struct RecordedValuesIteration
+{
+    static const bool visitsEmptyCounts = false;
+
+    int32_t visitedIndex = -1;
+
+    template <typename State>
+    bool hasNext(const State& state)
+    {
+        return state.totalCountToCurrentIndex < state.totalCount;
+    }
+
+    template <typename State>
+    bool reachedIterationLevel(const State& state) const
+    {
+        return 0 != state.countAtThisValue && visitedIndex != state.currentIndex;
+    }
+
+    template <typename State>
+    void incrementIterationLevel(const State& state)
+    {
+        visitedIndex = state.currentIndex;
+    }
+
+    template <typename State>
+    int64_t valueIteratedTo(const State& state) const
+    {
+        return state.histogram->highestEquivalentValue(state.currentValueAtIndex);
+    }
+
+    template <typename State>
+    double percentileIteratedTo(const State& state) const
+    {
+        return (100.0 * (double) state.totalCountToCurrentIndex) / state.totalCount;
+    }
+};
+
+struct AllValuesIteration : RecordedValuesIteration
+{
+    static const bool visitsEmptyCounts = true;
+
+    template <typename State>
+    bool hasNext(const State& state)
+    {
+        return state.currentIndex < state.countsArrayLength - 1;
+    }
+
+    template <typename State>
+    bool reachedIterationLevel(const State& state) const
+    {
+        return visitedIndex != state.currentIndex;
+    }
 };
 
-std::ostream& operator<< (std::ostream& stream, const Histogram& matrix);
\ No newline at end of file
+// Steps of valueUnitsPerBucket, each reporting the counts recorded in it.
+struct LinearIteration : RecordedValuesIteration
+{
+    static const bool visitsEmptyCounts = true;
+
+    int64_t valueUnitsPerBucket;
+    int64_t currentStepHighestValueReportingLevel;
+    int64_t currentStepLowestValueReportingLevel;
+
+    explicit LinearIteration(int64_t valueUnitsPerBucket) :
+        valueUnitsPerBucket{ valueUnitsPerBucket },
+        currentStepHighestValueReportingLevel{ valueUnitsPerBucket - 1 },
+        currentStepLowestValueReportingLevel{ -1 }
+    {
+    }
+
+    template <typename State>
+    void start(const State& state)
+    {
+        currentStepLowestValueReportingLevel =
+            state.histogram->lowestEquivalentValue(currentStepHighestValueReportingLevel);
+    }
+
+    template <typename State>
+    bool hasNext(const State& state)
+    {
+        return RecordedValuesIteration::hasNext(state) ||
+               currentStepHighestValueReportingLevel + 1 < state.nextValueAtIndex;
+    }
+
+    template <typename State>
+    bool reachedIterationLevel(const State& state) const
+    {
+        return state.currentValueAtIndex >= currentStepLowestValueReportingLevel ||
+               state.currentIndex >= state.countsArrayLength - 1;
+    }
+
+    template <typename State>
+    void incrementIterationLevel(const State& state)
+    {
+        currentStepHighestValueReportingLevel += valueUnitsPerBucket;
+        currentStepLowestValueReportingLevel =
+            state.histogram->lowestEquivalentValue(currentStepHighestValueReportingLevel);
+    }
+
+    template <typename State>
+    int64_t valueIteratedTo(const State&) const
+    {
+        return currentStepHighestValueReportingLevel;
+    }
+};
+
+// Steps growing by logBase from valueUnitsInFirstBucket.
+struct LogarithmicIteration : LinearIteration
+{
+    double logBase;
+    double nextValueReportingLevel;
+
+    LogarithmicIteration(int64_t valueUnitsInFirstBucket, double logBase) :
+        LinearIteration{ valueUnitsInFirstBucket },
+        logBase{ logBase },
+        nextValueReportingLevel{ (double) valueUnitsInFirstBucket }
+    {
+    }
+
+    template <typename State>
+    bool hasNext(const State& state)
+    {
+        return RecordedValuesIteration::hasNext(state) ||
+               state.histogram->lowestEquivalentValue((int64_t) nextValueReportingLevel) < state.nextValueAtIndex;
+    }
+
+    template <typename State>
+    void incrementIterationLevel(const State& state)
+    {
+        nextValueReportingLevel *= logBase;
+        currentStepHighestValueReportingLevel = ((int64_t) nextValueReportingLevel) - 1;
+        currentStepLowestValueReportingLevel =
+            state.histogram->lowestEquivalentValue(currentStepHighestValueReportingLevel);
+    }
+};
+
+// Percentile levels, percentileTicksPerHalfDistance of them in each halving
+// of the distance to 100%, finishing with 100% itself.
+struct PercentileIteration : RecordedValuesIteration
+{
+    int32_t percentileTicksPerHalfDistance;
+    double percentileLevelToIterateTo = 0.0;
+    bool reachedLastRecordedValue = false;
+
+    explicit PercentileIteration(int32_t percentileTicksPerHalfDistance) :
+        percentileTicksPerHalfDistance{ percentileTicksPerHalfDistance }
+    {
+    }
+
+    template <typename State>
+    bool hasNext(const State& state)
+    {
+        if (RecordedValuesIteration::hasNext(state))
+        {
+            return true;
+        }
+        if (!reachedLastRecordedValue && state.totalCount > 0)
+        {
+            percentileLevelToIterateTo = 100.0;
+            reachedLastRecordedValue = true;
+            return true;
+        }
+        return false;
+    }
+
+    template <typename State>
+    bool reachedIterationLevel(const State& state) const
+    {
+        return 0 != state.countAtThisValue &&
+               (100.0 * (double) state.totalCountToCurrentIndex) / state.totalCount >= percentileLevelToIterateTo;
+    }
+
+    template <typename State>
+    void incrementIterationLevel(const State&)
+    {
+        int64_t percentileReportingTicks = percentileTicksPerHalfDistance *
+            (int64_t) pow(2, (int64_t) (log(100.0 / (100.0 - percentileLevelToIterateTo)) / log(2)) + 1);
+        percentileLevelToIterateTo += 100.0 / percentileReportingTicks;
+    }
+
+    template <typename State>
+    double percentileIteratedTo(const State&) const
+    {
+        return percentileLevelToIterateTo;
+    }
+};
+
+template <typename CountType, typename Policy>
+class HistogramIterator final
+{
+
+public:
+
+    typedef std::forward_iterator_tag iterator_category;
+    typedef typename BasicHistogram< CountType >::HistogramValue value_type;
+    typedef ptrdiff_t difference_type;
+    typedef const value_type* pointer;
+    typedef const value_type& reference;
+
+    // The end of any iteration.
+    explicit HistogramIterator(const Policy& policy) :
+        policy(policy),
+        done{ true }
+    {
+    }
+
+    HistogramIterator(const BasicHistogram< CountType >& histogram, const Policy& policy) :
+        policy(policy),
+        done{ false }
+    {
+        state.histogram                = &histogram;
+        state.countsArrayLength        = histogram.countsArrayLength;
+        state.totalCount               = histogram.totalCount;
+        state.countAtThisValue         = 0;
+        state.totalCountToCurrentIndex = 0;
+        state.totalValueToCurrentIndex = 0;
+        freshSubBucket                 = true;
+        prevValueIteratedTo            = 0;
+        totalCountToPrevIndex          = 0;
+        moveTo(indexToVisitFrom(0));
+        start(this->policy, 0);
+        advance();
+    }
+
+    reference operator*() const
+    {
+        return current;
+    }
+
+    pointer operator->() const
+    {
+        return &current;
+    }
+
+    HistogramIterator& operator++()
+    {
+        advance();
+        return *this;
+    }
+
+    bool operator==(const HistogramIterator& other) const
+    {
+        return done && other.done;
+    }
+
+    bool operator!=(const HistogramIterator& other) const
+    {
+        return !(*this == other);
+    }
+
+private:
+    Policy policy;
+    bool done;
+    HistogramIterationState< CountType > state;
+    bool freshSubBucket;
+    int64_t prevValueIteratedTo;
+    int64_t totalCountToPrevIndex;
+    value_type current;
+
+    // Only some policies need the histogram before the walk starts.
+    template <typename P>
+    auto start(P& policy, int) -> decltype(policy.start(state), void())
+    {
+        policy.start(state);
+    }
+
+    template <typename P>
+    void start(P&, long)
+    {
+    }
+
+    int32_t indexToVisitFrom(int32_t countsIndex) const
+    {
+        return Policy::visitsEmptyCounts ? countsIndex : state.histogram->occupancy.nextOccupied(countsIndex);
+    }
+
+    void moveTo(int32_t countsIndex)
+    {
+        state.currentIndex        = countsIndex;
+        state.currentValueAtIndex = state.histogram->valueFromCountsIndex(countsIndex);
+        state.nextValueAtIndex    = state.histogram->valueFromCountsIndex(countsIndex + 1);
+    }
+
+    void advance()
+    {
+        if (!policy.hasNext(state))
+        {
+            done = true;
+            return;
+        }
+
+        auto& histogram = *state.histogram;
+        while (state.currentIndex < state.countsArrayLength)
+        {
+            state.countAtThisValue = histogram.counts.get(state.currentIndex);
+            if (freshSubBucket)
+            {
+                state.totalCountToCurrentIndex += state.countAtThisValue;
+                state.totalValueToCurrentIndex +=
+                    state.countAtThisValue * histogram.medianValueFromCountsIndex(state.currentIndex);
+                freshSubBucket = false;
+            }
+
+            if (policy.reachedIterationLevel(state))
+            {
+                auto valueIteratedTo = policy.valueIteratedTo(state);
+                current.valueIteratedTo               = valueIteratedTo;
+                current.valueIteratedFrom             = prevValueIteratedTo;
+                current.countAtValueIteratedTo        = state.countAtThisValue;
+                current.countAddedInThisIterationStep = state.totalCountToCurrentIndex - totalCountToPrevIndex;
+                current.totalCountToThisValue         = state.totalCountToCurrentIndex;
+                current.totalValueToThisValue         = state.totalValueToCurrentIndex;
+                current.percentile                    = (100.0 * (double) state.totalCountToCurrentIndex) / state.totalCount;
+                current.percentileLevelIteratedTo     = policy.percentileIteratedTo(state);
+                prevValueIteratedTo   = valueIteratedTo;
+                totalCountToPrevIndex = state.totalCountToCurrentIndex;
+                policy.incrementIterationLevel(state);
+                return;
+            }
+
+            freshSubBucket = true;
+            moveTo(indexToVisitFrom(state.currentIndex + 1));
+        }
+        done = true;
+    }
+
+};
+
+template <typename CountType, typename Policy>
+class HistogramIterationRange final
+{
+
+public:
+
+    HistogramIterationRange(const BasicHistogram< CountType >& histogram, const Policy& policy) :
+        histogram(histogram),
+        policy(policy)
+    {
+    }
+
+    HistogramIterator< CountType, Policy > begin() const
+    {
+        return HistogramIterator< CountType, Policy >{ histogram, policy };
+    }
+
+    HistogramIterator< CountType, Policy > end() const
+    {
+        return HistogramIterator< CountType, Policy >{ policy };
+    }
+
+private:
+    const BasicHistogram< CountType >& histogram;
+    Policy policy;
+
+};
+
+template <typename CountType>
+HistogramIterationRange< CountType, AllValuesIteration > BasicHistogram<CountType>::allValues() const
+{
+    return HistogramIterationRange< CountType, AllValuesIteration >{ *this, AllValuesIteration{} };
+}
+
+template <typename CountType>
+HistogramIterationRange< CountType, RecordedValuesIteration > BasicHistogram<CountType>::recordedValues() const
+{
+    return HistogramIterationRange< CountType, RecordedValuesIteration >{ *this, RecordedValuesIteration{} };
+}
+
+template <typename CountType>
+HistogramIterationRange< CountType, LinearIteration >
+BasicHistogram<CountType>::linearBucketValues(int64_t valueUnitsPerBucket) const
+{
+    return HistogramIterationRange< CountType, LinearIteration >{ *this, LinearIteration{ valueUnitsPerBucket } };
+}
+
+template <typename CountType>
+HistogramIterationRange< CountType, LogarithmicIteration >
+BasicHistogram<CountType>::logarithmicBucketValues(int64_t valueUnitsInFirstBucket, double logBase) const
+{
+    return HistogramIterationRange< CountType, LogarithmicIteration >{
+        *this, LogarithmicIteration{ valueUnitsInFirstBucket, logBase } };
+}
+
+template <typename CountType>
+HistogramIterationRange< CountType, PercentileIteration >
+BasicHistogram<CountType>::percentiles(int32_t percentileTicksPerHalfDistance) const
+{
+    return HistogramIterationRange< CountType, PercentileIteration >{
+        *this, PercentileIteration{ percentileTicksPerHalfDistance } };
+}
+
+template <typename CountType>
+template <typename Visitor>
+void BasicHistogram<CountType>::forAll(Visitor visitor) const
+{
+    // Blocks the occupancy bitmap marks as empty hold only zero counts, which
+    // are skipped rather than visited.
+    int64_t countToIndex = 0;
+    for (int32_t i = occupancy.nextOccupied(0);
+         i < countsArrayLength && countToIndex < totalCount;
+         i = occupancy.nextOccupied(i + 1))
+    {
+        auto count = counts.get(i);
+        visitor(valueFromCountsIndex(i), (int64_t) count);
+        countToIndex += count;
+    }
+}
+
+template <typename CountType>
+template <typename Visitor>
+void BasicHistogram<CountType>::forPercentiles(const int32_t tickPerHalfDistance, Visitor visitor) const
+{
+    for (auto& value : percentiles(tickPerHalfDistance))
+    {
+        visitor(value.getPercentileLevelIteratedTo(), value.getValueIteratedTo(), value.getTotalCountToThisValue());
+    }
+}
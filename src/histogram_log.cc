@@ -0,0 +1,348 @@
+#include <stdint.h>
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <assert.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <limits>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
+#include "histogram.h"
+#include "base64.h"
+#include "histogram_log.h"
+
+static const char LOG_FORMAT_VERSION[] = "1.3";
+static const char START_TIME_PREFIX[]  = "#[StartTime: ";
+static const char BASE_TIME_PREFIX[]   = "#[BaseTime: ";
+static const char TAG_PREFIX[]         = "Tag=";
+
+// Room for a tag prefix and three "%.3f," columns ahead of the base64 payload.
+static const size_t INTERVAL_LINE_PREFIX_LENGTH = 128;
+
+// Interval timestamps more than a year before the log's start time are
+// taken to be relative to it rather than absolute.
+static const double RELATIVE_TIMESTAMP_THRESHOLD_SEC = 365 * 24 * 3600.0;
+
+static bool startsWith(const std::string& line, const char* prefix, size_t prefixLength)
+{
+    return 0 == line.compare(0, prefixLength, prefix);
+}
+
+/////////////////// Writer /////////////////////
+
+HistogramLogWriter::HistogramLogWriter(std::ostream& out) :
+    out(out),
+    baseTime{ 0.0 },
+    encodingBuffer{},
+    lineBuffer{}
+{
+}
+
+HistogramLogWriter::~HistogramLogWriter()
+{
+}
+
+void HistogramLogWriter::outputLogFormatVersion()
+{
+    out << "#[Histogram log format version " << LOG_FORMAT_VERSION << "]\n";
+}
+
+void HistogramLogWriter::outputComment(const std::string& comment)
+{
+    out << "#" << comment << "\n";
+}
+
+void HistogramLogWriter::outputStartTime(double startTimeSec)
+{
+    char date[64];
+    struct tm calendar;
+    auto seconds = (time_t) startTimeSec;
+    strftime(date, sizeof(date), "%a %b %d %H:%M:%S UTC %Y", gmtime_r(&seconds, &calendar));
+
+    char line[128];
+    snprintf(line, sizeof(line), "%s%.3f (seconds since epoch), %s]\n", START_TIME_PREFIX, startTimeSec, date);
+    out << line;
+}
+
+void HistogramLogWriter::outputBaseTime(double baseTimeSec)
+{
+    char line[96];
+    snprintf(line, sizeof(line), "%s%.3f (seconds since epoch)]\n", BASE_TIME_PREFIX, baseTimeSec);
+    out << line;
+}
+
+void HistogramLogWriter::outputLegend()
+{
+    out << "\"StartTimestamp\",\"Interval_Length\",\"Interval_Max\",\"Interval_Compressed_Histogram\"\n";
+}
+
+void HistogramLogWriter::setBaseTime(double baseTimeSec)
+{
+    baseTime = baseTimeSec;
+}
+
+double HistogramLogWriter::getBaseTime() const
+{
+    return baseTime;
+}
+
+void HistogramLogWriter::outputIntervalHistogram(double startTimeStampSec, double endTimeStampSec,
+                                                 const Histogram& histogram, double maxValueUnitRatio)
+{
+    outputIntervalHistogram(startTimeStampSec, endTimeStampSec, histogram, std::string{}, maxValueUnitRatio);
+}
+
+void HistogramLogWriter::outputIntervalHistogram(double startTimeStampSec, double endTimeStampSec,
+                                                 const Histogram& histogram, const std::string& tag,
+                                                 double maxValueUnitRatio)
+{
+    assert(std::string::npos == tag.find_first_of(", \t\r\n"));
+
+    auto neededCapacity = histogram.getNeededByteBufferCapacity();
+    if (encodingBuffer.size() < neededCapacity)
+    {
+        encodingBuffer.resize(neededCapacity);
+    }
+    auto encodedLength = histogram.encodeIntoCompressedByteBuffer(encodingBuffer.data(), encodingBuffer.size());
+    assert(0 != encodedLength);
+
+    auto neededLineLength = tag.size() + INTERVAL_LINE_PREFIX_LENGTH + base64EncodedLength(encodedLength) + 1;
+    if (lineBuffer.size() < neededLineLength)
+    {
+        lineBuffer.resize(neededLineLength);
+    }
+
+    auto length = (size_t) snprintf(lineBuffer.data(), lineBuffer.size(), "%s%s%s%.3f,%.3f,%.3f,",
+                                    tag.empty() ? "" : TAG_PREFIX, tag.c_str(), tag.empty() ? "" : ",",
+                                    startTimeStampSec - baseTime, endTimeStampSec - startTimeStampSec,
+                                    histogram.getMaxValue() / maxValueUnitRatio);
+    length += base64Encode(encodingBuffer.data(), encodedLength, lineBuffer.data() + length);
+    lineBuffer[length++] = '\n';
+    out.write(lineBuffer.data(), length);
+}
+
+/////////////////// Reader /////////////////////
+
+HistogramLogReader::HistogramLogReader(std::istream& in) :
+    in(in),
+    line{},
+    decodingBuffer{},
+    offset{ std::max< int64_t >(0, (int64_t) in.tellg()) },
+    intervalPosition{},
+    startTimeSec{ 0.0 },
+    observedStartTime{ false },
+    baseTimeSec{ 0.0 },
+    observedBaseTime{ false },
+    intervalStartTimeSec{ 0.0 },
+    intervalEndTimeSec{ 0.0 },
+    intervalTag{},
+    payloadOffset{ 0 },
+    skippedIntervalCount{ 0 }
+{
+}
+
+HistogramLogReader::~HistogramLogReader()
+{
+}
+
+std::unique_ptr< Histogram > HistogramLogReader::nextIntervalHistogram()
+{
+    return nextIntervalHistogram(std::numeric_limits< double >::lowest(), std::numeric_limits< double >::max());
+}
+
+std::unique_ptr< Histogram > HistogramLogReader::nextIntervalHistogram(double rangeStartTimeSec, double rangeEndTimeSec)
+{
+    while (nextInterval())
+    {
+        if (intervalStartTimeSec < rangeStartTimeSec)
+        {
+            continue;
+        }
+        if (intervalStartTimeSec > rangeEndTimeSec)
+        {
+            return nullptr;
+        }
+
+        auto histogram = decodeInterval();
+        if (histogram)
+        {
+            return histogram;
+        }
+        skippedIntervalCount++;
+    }
+    return nullptr;
+}
+
+int64_t HistogramLogReader::getSkippedIntervalCount() const
+{
+    return skippedIntervalCount;
+}
+
+double HistogramLogReader::getStartTimeSec() const
+{
+    return startTimeSec;
+}
+
+double HistogramLogReader::getBaseTimeSec() const
+{
+    return baseTimeSec;
+}
+
+double HistogramLogReader::getIntervalStartTimeSec() const
+{
+    return intervalStartTimeSec;
+}
+
+double HistogramLogReader::getIntervalEndTimeSec() const
+{
+    return intervalEndTimeSec;
+}
+
+const std::string& HistogramLogReader::getIntervalTag() const
+{
+    return intervalTag;
+}
+
+// Reads up to and parses the next interval line, taking note of any start
+// and base time lines on the way.  Lines that do not parse are skipped.  A
+// line without its newline is deliberately not taken: in a log that is still
+// being written it may be half written, so it is left to be read whole once
+// the writer has finished it.  A finished log must end with a newline, as
+// HistogramLogWriter's do.
+bool HistogramLogReader::nextInterval()
+{
+    HistogramLogPosition lineStart = getPosition();
+    while (std::getline(in, line) && !in.eof())
+    {
+        offset += line.size() + 1;
+
+        while (!line.empty() && ('\r' == line.back() || ' ' == line.back()))
+        {
+            line.pop_back();
+        }
+
+        if (startsWith(line, START_TIME_PREFIX, sizeof(START_TIME_PREFIX) - 1))
+        {
+            startTimeSec = strtod(line.c_str() + sizeof(START_TIME_PREFIX) - 1, nullptr);
+            observedStartTime = true;
+        }
+        else if (startsWith(line, BASE_TIME_PREFIX, sizeof(BASE_TIME_PREFIX) - 1))
+        {
+            baseTimeSec = strtod(line.c_str() + sizeof(BASE_TIME_PREFIX) - 1, nullptr);
+            observedBaseTime = true;
+        }
+        else if (!line.empty() && '#' != line[0] && '"' != line[0] && parseIntervalLine())
+        {
+            intervalPosition = lineStart;
+            return true;
+        }
+        lineStart = getPosition();
+    }
+
+    // Leave the stream usable, and at the start of any incomplete line, for
+    // when the log has grown.
+    in.clear();
+    in.seekg(lineStart.offset);
+    return false;
+}
+
+HistogramLogPosition HistogramLogReader::getPosition() const
+{
+    return HistogramLogPosition{ offset, startTimeSec, observedStartTime, baseTimeSec, observedBaseTime };
+}
+
+HistogramLogPosition HistogramLogReader::getIntervalPosition() const
+{
+    return intervalPosition;
+}
+
+void HistogramLogReader::seek(const HistogramLogPosition& position)
+{
+    in.clear();
+    in.seekg(position.offset);
+    offset            = position.offset;
+    startTimeSec      = position.startTimeSec;
+    observedStartTime = position.observedStartTime;
+    baseTimeSec       = position.baseTimeSec;
+    observedBaseTime  = position.observedBaseTime;
+}
+
+bool HistogramLogReader::parseIntervalLine()
+{
+    const char* cursor = line.c_str();
+    intervalTag.clear();
+    if (startsWith(line, TAG_PREFIX, sizeof(TAG_PREFIX) - 1))
+    {
+        auto comma = line.find(',');
+        if (std::string::npos == comma)
+        {
+            return false;
+        }
+        intervalTag.assign(line, sizeof(TAG_PREFIX) - 1, comma - (sizeof(TAG_PREFIX) - 1));
+        cursor += comma + 1;
+    }
+
+    // Start timestamp, interval length and max value, each followed by a comma.
+    double columns[3];
+    for (auto& column : columns)
+    {
+        char* end;
+        column = strtod(cursor, &end);
+        if (end == cursor || ',' != *end)
+        {
+            return false;
+        }
+        cursor = end + 1;
+    }
+    payloadOffset = cursor - line.c_str();
+
+    double logTimeStampSec = columns[0];
+    if (!observedBaseTime)
+    {
+        baseTimeSec = (observedStartTime && logTimeStampSec < startTimeSec - RELATIVE_TIMESTAMP_THRESHOLD_SEC) ?
+            startTimeSec : 0.0;
+        observedBaseTime = true;
+    }
+
+    intervalStartTimeSec = logTimeStampSec + baseTimeSec;
+    intervalEndTimeSec   = intervalStartTimeSec + columns[1];
+    if (!observedStartTime)
+    {
+        startTimeSec = intervalStartTimeSec;
+        observedStartTime = true;
+    }
+    return true;
+}
+
+bool HistogramLogReader::decodeIntervalPayload(size_t& decodedLength)
+{
+    auto payloadLength = line.size() - payloadOffset;
+    if (decodingBuffer.size() < base64DecodedLength(payloadLength))
+    {
+        decodingBuffer.resize(base64DecodedLength(payloadLength));
+    }
+    return base64Decode(line.c_str() + payloadOffset, payloadLength, decodingBuffer.data(), decodedLength);
+}
+
+std::unique_ptr< Histogram > HistogramLogReader::decodeInterval()
+{
+    size_t decodedLength;
+    if (!decodeIntervalPayload(decodedLength))
+    {
+        return nullptr;
+    }
+    return Histogram::decodeFromCompressedByteBuffer(decodingBuffer.data(), decodedLength);
+}
+
+bool HistogramLogReader::addIntervalTo(Histogram& histogram)
+{
+    size_t decodedLength;
+    return decodeIntervalPayload(decodedLength) && histogram.addEncoded(decodingBuffer.data(), decodedLength);
+}
@@ -0,0 +1,136 @@
+
+// Required includes
+// #include <stdint.h>
+// #include <math.h>
+// #include <iostream>
+// #include <string>
+// #include <vector>
+// #include <memory>
+// #include <limits>
+// #include <algorithm>
+// #include <functional>
+// #include <iterator>
+// #include <assert.h>
+// #include "histogram.h"
+
+// Writes interval histograms in the .hlog text format read by the Java
+// HistogramLogProcessor and plotting tools: one line per interval holding its
+// start time, length and max value, and its V2 compressed encoding in base64.
+// The encoding and line buffers are kept between calls, so logging an
+// interval costs an encode and a single write.
+class HistogramLogWriter final
+{
+
+public:
+
+    explicit HistogramLogWriter(std::ostream& out);
+    ~HistogramLogWriter();
+
+    void outputLogFormatVersion();
+    void outputComment(const std::string& comment);
+    void outputStartTime(double startTimeSec);
+    void outputBaseTime(double baseTimeSec);
+    void outputLegend();
+
+    // Interval start times are written relative to the base time, which is
+    // 0 (so absolute) unless set.
+    void setBaseTime(double baseTimeSec);
+    double getBaseTime() const;
+
+    // The max value column is divided by maxValueUnitRatio, which by
+    // convention turns nanosecond values into milliseconds.
+    void outputIntervalHistogram(double startTimeStampSec, double endTimeStampSec,
+                                 const Histogram& histogram, double maxValueUnitRatio = 1000000.0);
+    void outputIntervalHistogram(double startTimeStampSec, double endTimeStampSec,
+                                 const Histogram& histogram, const std::string& tag,
+                                 double maxValueUnitRatio = 1000000.0);
+
+private:
+    std::ostream& out;
+    double baseTime;
+    std::vector< uint8_t > encodingBuffer;
+    std::vector< char > lineBuffer;
+
+};
+
+// Where a reader is in a log, with the start and base times in force there:
+// enough for another reader on the same log to carry on from that point.
+struct HistogramLogPosition
+{
+    int64_t offset;
+    double startTimeSec;
+    bool observedStartTime;
+    double baseTimeSec;
+    bool observedBaseTime;
+};
+
+// Reads a .hlog file one interval at a time, holding only the current line
+// and its decoding buffer in memory.  Comment, start time, base time and
+// legend lines are handled as the Java reader handles them, including
+// deducing whether interval timestamps are absolute or relative.
+class HistogramLogReader final
+{
+
+public:
+
+    explicit HistogramLogReader(std::istream& in);
+    ~HistogramLogReader();
+
+    // Returns nullptr at the end of the log.  Intervals whose payload does
+    // not decode are skipped, and counted by getSkippedIntervalCount.
+    std::unique_ptr< Histogram > nextIntervalHistogram();
+
+    // Skips, without decoding, intervals starting before rangeStartTimeSec
+    // and returns nullptr on reaching one starting after rangeEndTimeSec.
+    // Times are absolute, in seconds since the epoch.
+    std::unique_ptr< Histogram > nextIntervalHistogram(double rangeStartTimeSec, double rangeEndTimeSec);
+
+    // Advances to the next interval without decoding it, returning false at
+    // the end of the log.  A final line still being written (one without a
+    // newline) is left unread, so reading can resume once it is complete.
+    bool nextInterval();
+
+    // Adds the counts of the interval last read to histogram, with no
+    // intermediate Histogram.  Returns false if its encoding is malformed.
+    bool addIntervalTo(Histogram& histogram);
+
+    // Positions just past the last line read, and at the start of the last
+    // interval read; seek to either to resume there.
+    HistogramLogPosition getPosition() const;
+    HistogramLogPosition getIntervalPosition() const;
+    void seek(const HistogramLogPosition& position);
+
+    double getStartTimeSec() const;
+    double getBaseTimeSec() const;
+
+    // Of the interval last returned, in absolute seconds.
+    double getIntervalStartTimeSec() const;
+    double getIntervalEndTimeSec() const;
+    const std::string& getIntervalTag() const;
+
+    // Intervals nextIntervalHistogram has passed over as malformed.
+    int64_t getSkippedIntervalCount() const;
+
+private:
+    std::istream& in;
+    std::string line;
+    std::vector< uint8_t > decodingBuffer;
+
+    int64_t offset;
+    HistogramLogPosition intervalPosition;
+    double startTimeSec;
+    bool observedStartTime;
+    double baseTimeSec;
+    bool observedBaseTime;
+
+    double intervalStartTimeSec;
+    double intervalEndTimeSec;
+    std::string intervalTag;
+    size_t payloadOffset;
+    int64_t skippedIntervalCount;
+
+    bool parseIntervalLine();
+    std::unique_ptr< Histogram > decodeInterval();
+    bool decodeIntervalPayload(size_t& decodedLength);
+
+};
@@ -0,0 +1,148 @@
+#include <stdint.h>
+#include <math.h>
+#include <stdio.h>
+#include <assert.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <limits>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
+#include "histogram.h"
+#include "histogram_log.h"
+#include "histogram_log_index.h"
+
+static const char INDEX_VERSION_LINE[] = "#[HistogramLogIndex version 1]";
+static const char STRIDE_FORMAT[]      = "#[Stride: %d]";
+static const char RESUME_FORMAT[]      = "#[Resume: %lld,%lf,%d,%lf,%d,%lld]";
+static const char ENTRY_FORMAT[]       = "%lf,%lld,%lf,%d,%lf,%d";
+
+static const HistogramLogPosition LOG_START{ 0, 0.0, false, 0.0, false };
+
+HistogramLogIndex::HistogramLogIndex(int32_t strideIntervals) :
+    strideIntervals{ strideIntervals },
+    entries{},
+    resumePosition(LOG_START),
+    intervalsSinceEntry{ 0 }
+{
+    assert(strideIntervals > 0);
+}
+
+HistogramLogIndex::~HistogramLogIndex()
+{
+}
+
+void HistogramLogIndex::clear()
+{
+    entries.clear();
+    resumePosition      = LOG_START;
+    intervalsSinceEntry = 0;
+}
+
+size_t HistogramLogIndex::getEntryCount() const
+{
+    return entries.size();
+}
+
+const HistogramLogPosition& HistogramLogIndex::getEntryPosition(size_t entry) const
+{
+    assert(entry < entries.size());
+    return entries[entry].position;
+}
+
+int32_t HistogramLogIndex::getStrideIntervals() const
+{
+    return strideIntervals;
+}
+
+void HistogramLogIndex::update(std::istream& log)
+{
+    HistogramLogReader reader{ log };
+    reader.seek(resumePosition);
+    while (reader.nextInterval())
+    {
+        if (0 == intervalsSinceEntry++ % strideIntervals)
+        {
+            entries.push_back(Entry{ reader.getIntervalStartTimeSec(), reader.getIntervalPosition() });
+        }
+    }
+    resumePosition = reader.getPosition();
+}
+
+void HistogramLogIndex::seek(HistogramLogReader& reader, double timeSec) const
+{
+    // The last entry starting strictly before timeSec: intervals starting at
+    // exactly timeSec may precede the first entry that does.
+    auto next = std::lower_bound(entries.begin(), entries.end(), timeSec, [] (const Entry& entry, double time)
+    {
+        return entry.intervalStartTimeSec < time;
+    });
+    reader.seek((next == entries.begin()) ? LOG_START : (next - 1)->position);
+}
+
+void HistogramLogIndex::save(std::ostream& out) const
+{
+    char line[256];
+    out << INDEX_VERSION_LINE << "\n";
+    snprintf(line, sizeof(line), STRIDE_FORMAT, strideIntervals);
+    out << line << "\n";
+    snprintf(line, sizeof(line), RESUME_FORMAT, (long long) resumePosition.offset,
+             resumePosition.startTimeSec, (int) resumePosition.observedStartTime,
+             resumePosition.baseTimeSec, (int) resumePosition.observedBaseTime, (long long) intervalsSinceEntry);
+    out << line << "\n";
+
+    for (auto& entry : entries)
+    {
+        snprintf(line, sizeof(line), ENTRY_FORMAT, entry.intervalStartTimeSec, (long long) entry.position.offset,
+                 entry.position.startTimeSec, (int) entry.position.observedStartTime,
+                 entry.position.baseTimeSec, (int) entry.position.observedBaseTime);
+        out << line << "\n";
+    }
+}
+
+bool HistogramLogIndex::load(std::istream& in)
+{
+    clear();
+
+    std::string line;
+    int stride;
+    long long offset;
+    long long intervals;
+    int observedStartTime;
+    int observedBaseTime;
+    if (!std::getline(in, line) || line != INDEX_VERSION_LINE ||
+        !std::getline(in, line) || 1 != sscanf(line.c_str(), STRIDE_FORMAT, &stride) || stride <= 0 ||
+        !std::getline(in, line) ||
+        6 != sscanf(line.c_str(), RESUME_FORMAT, &offset, &resumePosition.startTimeSec, &observedStartTime,
+                    &resumePosition.baseTimeSec, &observedBaseTime, &intervals))
+    {
+        clear();
+        return false;
+    }
+    strideIntervals = stride;
+    resumePosition.offset            = offset;
+    resumePosition.observedStartTime = (0 != observedStartTime);
+    resumePosition.observedBaseTime  = (0 != observedBaseTime);
+    intervalsSinceEntry              = intervals;
+
+    while (std::getline(in, line))
+    {
+        Entry entry;
+        if (6 != sscanf(line.c_str(), ENTRY_FORMAT, &entry.intervalStartTimeSec, &offset,
+                        &entry.position.startTimeSec, &observedStartTime,
+                        &entry.position.baseTimeSec, &observedBaseTime))
+        {
+            clear();
+            return false;
+        }
+        entry.position.offset            = offset;
+        entry.position.observedStartTime = (0 != observedStartTime);
+        entry.position.observedBaseTime  = (0 != observedBaseTime);
+        entries.push_back(entry);
+    }
+    return true;
+}
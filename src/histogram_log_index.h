@@ -0,0 +1,61 @@
+
+// Required includes
+// #include <stdint.h>
+// #include <math.h>
+// #include <iostream>
+// #include <string>
+// #include <vector>
+// #include <memory>
+// #include <limits>
+// #include <algorithm>
+// #include <functional>
+// #include <iterator>
+// #include <assert.h>
+// #include "histogram.h"
+// #include "histogram_log.h"
+
+// Sidecar index of a .hlog file: the start time and byte position of every
+// strideIntervals-th interval, plus the reader state there.  Seeking with it
+// lets a time range query read only the intervals around the range, however
+// long the log.  The index remembers how far it has read, so update() on a
+// growing log only reads the lines added since.
+class HistogramLogIndex final
+{
+
+public:
+
+    explicit HistogramLogIndex(int32_t strideIntervals = 64);
+    ~HistogramLogIndex();
+
+    // Indexes the log's intervals beyond those already indexed.
+    void update(std::istream& log);
+
+    // Positions reader, which must be reading the indexed log, at or before
+    // the first interval starting at or after timeSec (absolute seconds).
+    void seek(HistogramLogReader& reader, double timeSec) const;
+
+    // The index file format: a version line, the stride and the resume
+    // position as comments, then one CSV line per entry.  Returns false,
+    // leaving the index empty, if in does not hold an index.
+    bool load(std::istream& in);
+    void save(std::ostream& out) const;
+
+    size_t getEntryCount() const;
+    const HistogramLogPosition& getEntryPosition(size_t entry) const;
+    int32_t getStrideIntervals() const;
+
+private:
+    struct Entry
+    {
+        double intervalStartTimeSec;
+        HistogramLogPosition position;
+    };
+
+    int32_t strideIntervals;
+    std::vector< Entry > entries;
+    HistogramLogPosition resumePosition;
+    int64_t intervalsSinceEntry;
+
+    void clear();
+
+};
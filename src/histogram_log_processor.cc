@@ -0,0 +1,342 @@
+#include <stdint.h>
+#include <math.h>
+#include <assert.h>
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <limits>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <atomic>
+#include <thread>
+
+#include "histogram.h"
+#include "histogram_log.h"
+#include "histogram_log_index.h"
+#include "histogram_log_processor.h"
+
+// Chunks per worker: enough for the workers to even out uneven chunks.
+static const unsigned CHUNKS_PER_THREAD = 4;
+
+static const HistogramLogPosition LOG_START{ 0, 0.0, false, 0.0, false };
+
+// A chunk's intervals, as windows: the first and last may be shared with the
+// neighbouring chunks, so are kept whole; those between are summarised.
+struct HistogramLogProcessor::Chunk
+{
+    HistogramLogPosition start;
+    int64_t endOffset;
+
+    int64_t firstWindow;
+    int64_t lastWindow;
+    std::unique_ptr< Histogram > first;
+    std::unique_ptr< Histogram > last;
+    std::vector< HistogramLogWindow > completed;
+
+    int64_t failedIntervalCount;
+};
+
+HistogramLogProcessor::HistogramLogProcessor(int64_t lowestDiscernibleValue,
+                                             int64_t highestTrackableValue,
+                                             int64_t numberOfSignificantValueDigits) :
+    lowestDiscernibleValue{ lowestDiscernibleValue },
+    highestTrackableValue{ highestTrackableValue },
+    numberOfSignificantValueDigits{ numberOfSignificantValueDigits },
+    threads{ std::max(1u, std::thread::hardware_concurrency()) },
+    windowLengthSec{ 0.0 },
+    percentiles{ 50.0, 90.0, 99.0, 99.9, 99.99 },
+    tag{},
+    index{ nullptr },
+    histogram{ lowestDiscernibleValue, highestTrackableValue, numberOfSignificantValueDigits },
+    windows{},
+    failedIntervalCount{ 0 }
+{
+    histogram.setAutoResize(true);
+}
+
+HistogramLogProcessor::~HistogramLogProcessor()
+{
+}
+
+void HistogramLogProcessor::setThreads(unsigned threads)
+{
+    this->threads = std::max(1u, threads);
+}
+
+void HistogramLogProcessor::setWindowLength(double windowLengthSec)
+{
+    this->windowLengthSec = windowLengthSec;
+}
+
+void HistogramLogProcessor::setPercentiles(const std::vector< double >& percentiles)
+{
+    this->percentiles = percentiles;
+}
+
+void HistogramLogProcessor::setTag(const std::string& tag)
+{
+    this->tag = tag;
+}
+
+void HistogramLogProcessor::setIndex(const HistogramLogIndex* index)
+{
+    this->index = index;
+}
+
+const Histogram& HistogramLogProcessor::getHistogram() const
+{
+    return histogram;
+}
+
+const std::vector< HistogramLogWindow >& HistogramLogProcessor::getWindows() const
+{
+    return windows;
+}
+
+const std::vector< double >& HistogramLogProcessor::getPercentiles() const
+{
+    return percentiles;
+}
+
+int64_t HistogramLogProcessor::getFailedIntervalCount() const
+{
+    return failedIntervalCount;
+}
+
+std::unique_ptr< Histogram > HistogramLogProcessor::newHistogram() const
+{
+    std::unique_ptr< Histogram > windowHistogram{
+        new Histogram{ lowestDiscernibleValue, highestTrackableValue, numberOfSignificantValueDigits } };
+    windowHistogram->setAutoResize(true);
+    return windowHistogram;
+}
+
+HistogramLogWindow HistogramLogProcessor::summarise(int64_t window, double originTimeSec,
+                                                    const Histogram& windowHistogram) const
+{
+    HistogramLogWindow summary{ originTimeSec + window * windowLengthSec,
+                                originTimeSec + (window + 1) * windowLengthSec,
+                                HistogramSummary{}, std::vector< int64_t >(percentiles.size()) };
+    windowHistogram.getPercentileSummary(percentiles.data(), percentiles.size(),
+                                         summary.percentileValues.data(), summary.summary);
+    return summary;
+}
+
+bool HistogramLogProcessor::process(const std::string& logPath)
+{
+    histogram.reset();
+    windows.clear();
+    failedIntervalCount = 0;
+
+    std::ifstream log{ logPath, std::ios::binary };
+    if (!log)
+    {
+        return false;
+    }
+
+    // The first interval settles the start and base times, which every chunk
+    // split at a byte offset starts out with.
+    HistogramLogReader reader{ log };
+    if (!reader.nextInterval())
+    {
+        return true;
+    }
+    auto settled       = reader.getPosition();
+    auto originTimeSec = reader.getStartTimeSec();
+
+    log.clear();
+    log.seekg(0, std::ios::end);
+    auto logLength = (int64_t) log.tellg();
+
+    size_t chunkCount = threads * CHUNKS_PER_THREAD;
+    std::vector< HistogramLogPosition > starts{ LOG_START };
+    if (nullptr != index && index->getEntryCount() > 1)
+    {
+        auto entriesPerChunk = std::max< size_t >(1, (index->getEntryCount() + chunkCount - 1) / chunkCount);
+        for (size_t entry = entriesPerChunk; entry < index->getEntryCount(); entry += entriesPerChunk)
+        {
+            starts.push_back(index->getEntryPosition(entry));
+        }
+    }
+    else
+    {
+        std::string skipped;
+        for (size_t i = 1; i < chunkCount; i++)
+        {
+            // Move each split on to the start of the following line.
+            log.clear();
+            log.seekg(logLength * i / chunkCount - 1);
+            std::getline(log, skipped);
+            auto offset = log.eof() ? logLength : (int64_t) log.tellg();
+            if (offset > starts.back().offset)
+            {
+                starts.push_back(HistogramLogPosition{ offset, settled.startTimeSec, true, settled.baseTimeSec, true });
+            }
+        }
+    }
+
+    std::vector< Chunk > chunks(starts.size());
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        chunks[i].start     = starts[i];
+        chunks[i].endOffset = (i + 1 < starts.size()) ? starts[i + 1].offset : std::numeric_limits< int64_t >::max();
+        chunks[i].failedIntervalCount = 0;
+    }
+
+    // Workers take chunks in turn, each adding into its own total.
+    auto workers = std::min< size_t >(threads, chunks.size());
+    std::vector< std::unique_ptr< Histogram > > totals;
+    for (size_t i = 0; i < workers; i++)
+    {
+        totals.push_back(newHistogram());
+    }
+
+    std::atomic< size_t > nextChunk{ 0 };
+    auto work = [&] (size_t worker)
+    {
+        for (size_t chunk = nextChunk++; chunk < chunks.size(); chunk = nextChunk++)
+        {
+            processChunk(logPath, chunks[chunk], originTimeSec, *totals[worker]);
+        }
+    };
+
+    std::vector< std::thread > pool;
+    for (size_t worker = 1; worker < workers; worker++)
+    {
+        pool.emplace_back(work, worker);
+    }
+    work(0);
+    for (auto& thread : pool)
+    {
+        thread.join();
+    }
+
+    std::vector< const Histogram* > inputs;
+    for (auto& total : totals)
+    {
+        inputs.push_back(total.get());
+    }
+    mergeAll(inputs.data(), inputs.size(), histogram, threads);
+
+    // Stitch together the windows that straddle chunk boundaries.
+    std::unique_ptr< Histogram > pending;
+    int64_t pendingWindow = 0;
+    auto emit = [&] ()
+    {
+        windows.push_back(summarise(pendingWindow, originTimeSec, *pending));
+        histogram.add(*pending);
+    };
+    for (auto& chunk : chunks)
+    {
+        failedIntervalCount += chunk.failedIntervalCount;
+        if (!chunk.first)
+        {
+            continue;
+        }
+
+        if (pending && pendingWindow == chunk.firstWindow)
+        {
+            pending->add(*chunk.first);
+        }
+        else
+        {
+            if (pending)
+            {
+                emit();
+            }
+            pending       = std::move(chunk.first);
+            pendingWindow = chunk.firstWindow;
+        }
+
+        if (chunk.last)
+        {
+            emit();
+            windows.insert(windows.end(), chunk.completed.begin(), chunk.completed.end());
+            pending       = std::move(chunk.last);
+            pendingWindow = chunk.lastWindow;
+        }
+    }
+    if (pending)
+    {
+        emit();
+    }
+
+    if (windowLengthSec <= 0)
+    {
+        windows.clear();
+    }
+    return true;
+}
+
+void HistogramLogProcessor::processChunk(const std::string& logPath, Chunk& chunk, double originTimeSec,
+                                         Histogram& total) const
+{
+    std::ifstream log{ logPath, std::ios::binary };
+    HistogramLogReader reader{ log };
+    reader.seek(chunk.start);
+
+    // Each interval is decoded into scratch and only added once it has
+    // decoded in full, as addIntervalTo keeps whatever it added before a
+    // fault.
+    auto scratch = newHistogram();
+    std::unique_ptr< Histogram > current;
+    int64_t currentWindow = 0;
+    while (reader.nextInterval() && reader.getIntervalPosition().offset < chunk.endOffset)
+    {
+        if (reader.getIntervalTag() != tag)
+        {
+            continue;
+        }
+
+        // Out of order intervals stay in the current window.
+        int64_t window = (windowLengthSec > 0) ?
+            (int64_t) floor((reader.getIntervalStartTimeSec() - originTimeSec) / windowLengthSec) : 0;
+        if (!current)
+        {
+            current           = newHistogram();
+            currentWindow     = window;
+            chunk.firstWindow = window;
+        }
+        else if (window > currentWindow)
+        {
+            if (currentWindow == chunk.firstWindow)
+            {
+                chunk.first = std::move(current);
+                current     = newHistogram();
+            }
+            else
+            {
+                chunk.completed.push_back(summarise(currentWindow, originTimeSec, *current));
+                total.add(*current);
+                current->reset();
+            }
+            currentWindow = window;
+        }
+
+        scratch->reset();
+        if (!reader.addIntervalTo(*scratch))
+        {
+            chunk.failedIntervalCount++;
+            continue;
+        }
+        current->add(*scratch);
+    }
+
+    if (!current)
+    {
+        return;
+    }
+    if (currentWindow == chunk.firstWindow)
+    {
+        chunk.first = std::move(current);
+    }
+    else
+    {
+        chunk.last       = std::move(current);
+        chunk.lastWindow = currentWindow;
+    }
+}
@@ -0,0 +1,87 @@
+
+// Required includes
+// #include <stdint.h>
+// #include <math.h>
+// #include <iostream>
+// #include <string>
+// #include <vector>
+// #include <memory>
+// #include <limits>
+// #include <algorithm>
+// #include <functional>
+// #include <iterator>
+// #include <assert.h>
+// #include "histogram.h"
+// #include "histogram_log.h"
+// #include "histogram_log_index.h"
+
+// Percentiles of the intervals starting within one window of a log.
+struct HistogramLogWindow
+{
+    double startTimeSec;
+    double endTimeSec;
+    HistogramSummary summary;
+    std::vector< int64_t > percentileValues;
+};
+
+// Merges the intervals of a .hlog file using a pool of worker threads.  The
+// log is split into chunks at line boundaries (or at the entries of an index,
+// when given one) which the workers take in turn, each adding its intervals
+// straight from their encodings into its own histograms.  The per-worker
+// totals are combined with mergeAll at the end.
+//
+// Alongside the total, the intervals are summarised per window of
+// windowLengthSec, counted from the log's start time.  Only a window that
+// straddles two chunks is merged across workers; the others are summarised
+// by the worker that saw them.  Intervals are expected in start time order.
+class HistogramLogProcessor final
+{
+
+public:
+
+    HistogramLogProcessor(int64_t lowestDiscernibleValue,
+                          int64_t highestTrackableValue,
+                          int64_t numberOfSignificantValueDigits);
+    ~HistogramLogProcessor();
+
+    void setThreads(unsigned threads);
+    // 0 leaves out the window series.
+    void setWindowLength(double windowLengthSec);
+    void setPercentiles(const std::vector< double >& percentiles);
+    // Only intervals with this tag are processed; the default is untagged.
+    void setTag(const std::string& tag);
+    // Splits at the index's entries, which carry the exact base time in force
+    // there, rather than at byte offsets.  The index must outlive process().
+    void setIndex(const HistogramLogIndex* index);
+
+    // Returns false if the log cannot be opened.
+    bool process(const std::string& logPath);
+
+    const Histogram& getHistogram() const;
+    const std::vector< HistogramLogWindow >& getWindows() const;
+    const std::vector< double >& getPercentiles() const;
+    // Intervals of the tag whose payload did not decode; they are left out of
+    // both the windows and the total.
+    int64_t getFailedIntervalCount() const;
+
+private:
+    struct Chunk;
+
+    int64_t lowestDiscernibleValue;
+    int64_t highestTrackableValue;
+    int64_t numberOfSignificantValueDigits;
+    unsigned threads;
+    double windowLengthSec;
+    std::vector< double > percentiles;
+    std::string tag;
+    const HistogramLogIndex* index;
+
+    Histogram histogram;
+    std::vector< HistogramLogWindow > windows;
+    int64_t failedIntervalCount;
+
+    std::unique_ptr< Histogram > newHistogram() const;
+    void processChunk(const std::string& logPath, Chunk& chunk, double originTimeSec, Histogram& total) const;
+    HistogramLogWindow summarise(int64_t window, double originTimeSec, const Histogram& windowHistogram) const;
+
+};
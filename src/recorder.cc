@@ -0,0 +1,77 @@
+#include <stdint.h>
+#include <math.h>
+#include <assert.h>
+
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <iostream>
+#include <functional>
+#include <iterator>
+
+#include "histogram.h"
+#include "atomic_histogram.h"
+#include "writer_reader_phaser.h"
+#include "recorder.h"
+
+Recorder::Recorder(int64_t highestTrackableValue,
+                   int64_t numberOfSignificantValueDigits) :
+    first{ highestTrackableValue, numberOfSignificantValueDigits },
+    second{ highestTrackableValue, numberOfSignificantValueDigits },
+    activeHistogram{ &first }
+{
+}
+
+Recorder::~Recorder()
+{
+}
+
+void Recorder::recordValue(int64_t value)
+{
+    auto criticalValueAtEnter = recordingPhaser.writerCriticalSectionEnter();
+    activeHistogram.load()->recordValue(value);
+    recordingPhaser.writerCriticalSectionExit(criticalValueAtEnter);
+}
+
+void Recorder::recordValue(int64_t value, int64_t expectedInterval)
+{
+    auto criticalValueAtEnter = recordingPhaser.writerCriticalSectionEnter();
+    activeHistogram.load()->recordValue(value, expectedInterval);
+    recordingPhaser.writerCriticalSectionExit(criticalValueAtEnter);
+}
+
+const AtomicHistogram& Recorder::getIntervalHistogram()
+{
+    recordingPhaser.readerLock();
+
+    AtomicHistogram* interval = activeHistogram.load();
+    AtomicHistogram* inactive = (interval == &first) ? &second : &first;
+
+    // Nobody can be writing to the inactive histogram: the flip that retired
+    // it waited for its last writer to leave.
+    inactive->reset();
+    activeHistogram.store(inactive);
+    recordingPhaser.flipPhase();
+
+    recordingPhaser.readerUnlock();
+
+    return *interval;
+}
+
+void Recorder::reset()
+{
+    recordingPhaser.readerLock();
+
+    AtomicHistogram* retired  = activeHistogram.load();
+    AtomicHistogram* inactive = (retired == &first) ? &second : &first;
+
+    inactive->reset();
+    activeHistogram.store(inactive);
+    recordingPhaser.flipPhase();
+    retired->reset();
+
+    recordingPhaser.readerUnlock();
+}
@@ -0,0 +1,50 @@
+
+// Required includes
+// #include <stdint.h>
+// #include <atomic>
+// #include <mutex>
+// #include <memory>
+// #include <iostream>
+// #include <functional>
+// #include <math.h>
+// #include <vector>
+// #include <limits>
+// #include <algorithm>
+// #include <iterator>
+// #include <assert.h>
+// #include "histogram.h"
+// #include "atomic_histogram.h"
+// #include "writer_reader_phaser.h"
+
+// Records values from any number of threads into one of a pair of
+// AtomicHistograms, and hands a reporting thread the values recorded since its
+// previous call.  Recording is wait-free; getIntervalHistogram swaps the pair
+// without blocking writers and without allocating.
+class Recorder final
+{
+
+public:
+
+    Recorder(int64_t highestTrackableValue,
+             int64_t numberOfSignificantValueDigits);
+    ~Recorder();
+
+    Recorder(const Recorder&) = delete;
+    Recorder& operator=(const Recorder&) = delete;
+
+    void recordValue(int64_t value);
+    void recordValue(int64_t value, int64_t expectedInterval);
+
+    // Returns the values recorded since the previous call.  The histogram
+    // stays stable until the next call to getIntervalHistogram or reset, which
+    // recycle it, so only one thread should be reading intervals.
+    const AtomicHistogram& getIntervalHistogram();
+    void reset();
+
+private:
+    AtomicHistogram first;
+    AtomicHistogram second;
+    std::atomic< AtomicHistogram* > activeHistogram;
+    WriterReaderPhaser recordingPhaser;
+
+};
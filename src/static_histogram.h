@@ -0,0 +1,239 @@
+
+// Required includes
+// #include <stdint.h>
+// #include <x86intrin.h>
+// #include <math.h>
+// #include <assert.h>
+// #include <array>
+// #include <functional>
+
+// Histogram with its configuration fixed at compile time.  The bucket layout
+// that Histogram::init() works out at runtime is computed here by constexpr
+// functions, the counts are a std::array sized to fit, and recordValue reduces
+// to an lzcnt, two shifts and an increment with immediate operands.
+//
+// The counts are held inline, so large configurations should be given static
+// storage or allocated on the heap rather than placed on the stack.
+namespace static_histogram
+{
+    constexpr int64_t power(int64_t base, int64_t exp)
+    {
+        return (0 == exp) ? 1 : base * power(base, exp - 1);
+    }
+
+    constexpr int32_t ceilLog2(int64_t value, int32_t magnitude = 0)
+    {
+        return ((((int64_t) 1) << magnitude) >= value) ? magnitude : ceilLog2(value, magnitude + 1);
+    }
+
+    constexpr int32_t bucketsNeeded(int64_t trackableValue, int64_t highestTrackableValue)
+    {
+        return (trackableValue < highestTrackableValue) ?
+            1 + bucketsNeeded(trackableValue << 1, highestTrackableValue) : 1;
+    }
+}
+
+template <int64_t HighestTrackableValue, int32_t NumberOfSignificantValueDigits, typename CountType = int64_t>
+class StaticHistogram final
+{
+
+public:
+
+    static constexpr int64_t largestValueWithSingleUnitResolution =
+        2 * static_histogram::power(10, NumberOfSignificantValueDigits);
+    static constexpr int32_t subBucketCountMagnitude =
+        static_histogram::ceilLog2(largestValueWithSingleUnitResolution);
+    static constexpr int32_t subBucketHalfCountMagnitude =
+        ((subBucketCountMagnitude > 1) ? subBucketCountMagnitude : 1) - 1;
+    static constexpr int32_t subBucketCount     = 1 << (subBucketHalfCountMagnitude + 1);
+    static constexpr int32_t subBucketHalfCount = subBucketCount / 2;
+    static constexpr int64_t subBucketMask      = subBucketCount - 1;
+    static constexpr int32_t bucketCount =
+        static_histogram::bucketsNeeded(subBucketCount - 1, HighestTrackableValue);
+    static constexpr int32_t countsArrayLength  = (bucketCount + 1) * subBucketHalfCount;
+
+    StaticHistogram() : totalCount{ 0 }, counts{}
+    {
+    }
+
+    int64_t getHighestTrackableValue() const
+    {
+        return HighestTrackableValue;
+    }
+
+    int64_t getNumberOfSignificantValueDigits() const
+    {
+        return NumberOfSignificantValueDigits;
+    }
+
+    int64_t getTotalCount() const
+    {
+        return totalCount;
+    }
+
+    int64_t getCountAtValue(int64_t value) const
+    {
+        return counts[countsIndexFor(value)];
+    }
+
+    void recordValue(int64_t value)
+    {
+        counts[countsIndexFor(value)]++;
+        totalCount++;
+    }
+
+    // As Histogram::recordValue, the missing values that share a sub-bucket
+    // are added in one step, so the cost follows the sub-buckets touched.
+    void recordValue(int64_t value, int64_t expectedInterval)
+    {
+        recordValue(value);
+        if (expectedInterval <= 0 || value <= expectedInterval)
+        {
+            return;
+        }
+        int64_t missingValue = value - expectedInterval;
+        while (missingValue >= expectedInterval)
+        {
+            auto lowestInSubBucket = lowestEquivalentValue(missingValue);
+            auto lowestMissing     = (lowestInSubBucket > expectedInterval) ? lowestInSubBucket : expectedInterval;
+            auto missingCount      = ((missingValue - lowestMissing) / expectedInterval) + 1;
+
+            counts[countsIndexFor(missingValue)] += (CountType) missingCount;
+            totalCount += missingCount;
+            missingValue -= missingCount * expectedInterval;
+        }
+    }
+
+    void reset()
+    {
+        counts.fill(0);
+        totalCount = 0;
+    }
+
+    template <typename Visitor>
+    void forAll(Visitor func) const
+    {
+        int64_t countToIndex = 0;
+        for (int32_t i = 0; i < countsArrayLength && countToIndex < totalCount; i++)
+        {
+            func(valueFromCountsIndex(i), counts[i]);
+            countToIndex += counts[i];
+        }
+    }
+
+    int64_t getMaxValue() const
+    {
+        for (int32_t i = countsArrayLength - 1; i >= 0; i--)
+        {
+            if (0 != counts[i])
+            {
+                return valueFromCountsIndex(i);
+            }
+        }
+        return 0;
+    }
+
+    int64_t getMinValue() const
+    {
+        for (int32_t i = 0; i < countsArrayLength; i++)
+        {
+            if (0 != counts[i])
+            {
+                return valueFromCountsIndex(i);
+            }
+        }
+        return 0;
+    }
+
+    double getMeanValue() const
+    {
+        int64_t totalValue = 0;
+        forAll([&] (int64_t value, int64_t count)
+        {
+            totalValue += count * (lowestEquivalentValue(value) + (sizeOfEquivalentRange(value) >> 1));
+        });
+        return (totalValue * 1.0) / totalCount;
+    }
+
+    int64_t getValueAtPercentile(double requestedPercentile) const
+    {
+        auto percentile        = fmin(fmax(requestedPercentile, 0), 100.0);
+        auto countAtPercentile = (int64_t) (((percentile / 100.0) * totalCount) + 0.5);
+        countAtPercentile      = countAtPercentile > 1 ? countAtPercentile : 1;
+
+        int64_t totalToCurrentIndex = 0;
+        for (int32_t i = 0; i < countsArrayLength; i++)
+        {
+            totalToCurrentIndex += counts[i];
+            if (totalToCurrentIndex >= countAtPercentile)
+            {
+                return valueFromCountsIndex(i);
+            }
+        }
+        return 0;
+    }
+
+    int64_t lowestEquivalentValue(int64_t value) const
+    {
+        auto bucketIndex = getBucketIndex(value);
+        return (value >> bucketIndex) << bucketIndex;
+    }
+
+    int64_t sizeOfEquivalentRange(int64_t value) const
+    {
+        return ((int64_t) 1) << getBucketIndex(value);
+    }
+
+    bool valuesAreEquivalent(int64_t a, int64_t b) const
+    {
+        return lowestEquivalentValue(a) == lowestEquivalentValue(b);
+    }
+
+private:
+    int64_t totalCount;
+    std::array< CountType, countsArrayLength > counts;
+
+    static int32_t getBucketIndex(int64_t value)
+    {
+        return 63 - (int32_t) __lzcnt64(value | subBucketMask) - subBucketHalfCountMagnitude;
+    }
+
+    // countsArrayIndex(bucketIndex, value >> bucketIndex), simplified.
+    static int32_t countsIndexFor(int64_t value)
+    {
+        auto bucketIndex = getBucketIndex(value);
+        auto countsIndex = (bucketIndex << subBucketHalfCountMagnitude) + (int32_t) (value >> bucketIndex);
+        assert(countsIndex < countsArrayLength);
+        return countsIndex;
+    }
+
+    static int64_t valueFromCountsIndex(int32_t countsIndex)
+    {
+        auto bucketIndex    = (countsIndex >> subBucketHalfCountMagnitude) - 1;
+        auto subBucketIndex = (countsIndex & (subBucketHalfCount - 1)) + subBucketHalfCount;
+        if (bucketIndex < 0)
+        {
+            subBucketIndex -= subBucketHalfCount;
+            bucketIndex = 0;
+        }
+        return ((int64_t) subBucketIndex) << bucketIndex;
+    }
+
+};
+
+template <int64_t HighestTrackableValue, int32_t NumberOfSignificantValueDigits, typename CountType>
+constexpr int64_t StaticHistogram<HighestTrackableValue, NumberOfSignificantValueDigits, CountType>::largestValueWithSingleUnitResolution;
+template <int64_t HighestTrackableValue, int32_t NumberOfSignificantValueDigits, typename CountType>
+constexpr int32_t StaticHistogram<HighestTrackableValue, NumberOfSignificantValueDigits, CountType>::subBucketCountMagnitude;
+template <int64_t HighestTrackableValue, int32_t NumberOfSignificantValueDigits, typename CountType>
+constexpr int32_t StaticHistogram<HighestTrackableValue, NumberOfSignificantValueDigits, CountType>::subBucketHalfCountMagnitude;
+template <int64_t HighestTrackableValue, int32_t NumberOfSignificantValueDigits, typename CountType>
+constexpr int32_t StaticHistogram<HighestTrackableValue, NumberOfSignificantValueDigits, CountType>::subBucketCount;
+template <int64_t HighestTrackableValue, int32_t NumberOfSignificantValueDigits, typename CountType>
+constexpr int32_t StaticHistogram<HighestTrackableValue, NumberOfSignificantValueDigits, CountType>::subBucketHalfCount;
+template <int64_t HighestTrackableValue, int32_t NumberOfSignificantValueDigits, typename CountType>
+constexpr int64_t StaticHistogram<HighestTrackableValue, NumberOfSignificantValueDigits, CountType>::subBucketMask;
+template <int64_t HighestTrackableValue, int32_t NumberOfSignificantValueDigits, typename CountType>
+constexpr int32_t StaticHistogram<HighestTrackableValue, NumberOfSignificantValueDigits, CountType>::bucketCount;
+template <int64_t HighestTrackableValue, int32_t NumberOfSignificantValueDigits, typename CountType>
+constexpr int32_t StaticHistogram<HighestTrackableValue, NumberOfSignificantValueDigits, CountType>::countsArrayLength;
@@ -0,0 +1,150 @@
+#include <stdint.h>
+#include <math.h>
+#include <assert.h>
+
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <unordered_map>
+#include <iostream>
+#include <functional>
+#include <iterator>
+
+#include "histogram.h"
+#include "atomic_histogram.h"
+#include "striped_histogram.h"
+
+// Ids are never reused, so a thread's cached entry for a destroyed
+// StripedHistogram can never be mistaken for a live one.
+static std::atomic< uint64_t > nextStripedHistogramId{ 1 };
+
+struct StripedHistogram::Shard
+{
+    AtomicHistogram histogram;
+    // The reset epoch the owner last cleared the histogram for.
+    std::atomic< uint64_t > epoch;
+};
+
+struct LocalShard
+{
+    std::weak_ptr< const uint64_t > handle;
+    StripedHistogram::Shard* shard;
+};
+
+struct LocalShardCache
+{
+    uint64_t lastId = 0;
+    StripedHistogram::Shard* lastShard = nullptr;
+    std::unordered_map< uint64_t, LocalShard > shards;
+};
+
+static thread_local LocalShardCache localShards;
+
+StripedHistogram::StripedHistogram(int64_t highestTrackableValue,
+                                   int64_t numberOfSignificantValueDigits) :
+    id{ nextStripedHistogramId.fetch_add(1) },
+    handle{ std::make_shared< const uint64_t >(id) },
+    highestTrackableValue{ highestTrackableValue },
+    numberOfSignificantValueDigits{ numberOfSignificantValueDigits },
+    resetEpoch{ 0 }
+{
+}
+
+StripedHistogram::~StripedHistogram()
+{
+}
+
+int64_t StripedHistogram::getHighestTrackableValue() const
+{
+    return highestTrackableValue;
+}
+
+int64_t StripedHistogram::getNumberOfSignificantValueDigits() const
+{
+    return numberOfSignificantValueDigits;
+}
+
+size_t StripedHistogram::getShardCount() const
+{
+    std::lock_guard< std::mutex > lock{ shardsMutex };
+    return shards.size();
+}
+
+void StripedHistogram::recordValue(int64_t value)
+{
+    auto& shard = localShard();
+
+    // The epoch is only written by reset(), so checking it costs a load from
+    // a shared line.  Publishing the shard's epoch after clearing it tells
+    // snapshot() that its counts are current again.
+    auto epoch = resetEpoch.load(std::memory_order_acquire);
+    if (shard.epoch.load(std::memory_order_relaxed) != epoch)
+    {
+        shard.histogram.reset();
+        shard.epoch.store(epoch, std::memory_order_release);
+    }
+
+    shard.histogram.recordValueSingleWriter(value);
+}
+
+void StripedHistogram::snapshot(AtomicHistogram& target) const
+{
+    target.reset();
+
+    auto epoch = resetEpoch.load(std::memory_order_acquire);
+    std::lock_guard< std::mutex > lock{ shardsMutex };
+    for (auto& shard : shards)
+    {
+        if (shard->epoch.load(std::memory_order_acquire) == epoch)
+        {
+            target.add(shard->histogram);
+        }
+    }
+}
+
+void StripedHistogram::reset()
+{
+    resetEpoch.fetch_add(1, std::memory_order_release);
+}
+
+StripedHistogram::Shard& StripedHistogram::localShard()
+{
+    auto& cache = localShards;
+    if (cache.lastId == id)
+    {
+        return *cache.lastShard;
+    }
+
+    auto found = cache.shards.find(id);
+    Shard* shard = (found != cache.shards.end()) ? found->second.shard : &registerShard();
+
+    cache.lastId    = id;
+    cache.lastShard = shard;
+    return *shard;
+}
+
+StripedHistogram::Shard& StripedHistogram::registerShard()
+{
+    std::unique_ptr< Shard > shard{ new Shard{ AtomicHistogram{ highestTrackableValue, numberOfSignificantValueDigits },
+                                               { resetEpoch.load(std::memory_order_relaxed) } } };
+    Shard* registered = shard.get();
+
+    {
+        std::lock_guard< std::mutex > lock{ shardsMutex };
+        shards.push_back(std::move(shard));
+    }
+
+    // Take the chance to forget the shards of instances since destroyed, so
+    // a thread that outlives many instances does not keep an entry for each.
+    auto& cached = localShards.shards;
+    for (auto entry = cached.begin(); entry != cached.end(); )
+    {
+        entry = entry->second.handle.expired() ? cached.erase(entry) : std::next(entry);
+    }
+
+    cached[id] = LocalShard{ handle, registered };
+    return *registered;
+}
@@ -0,0 +1,70 @@
+
+// Required includes
+// #include <stdint.h>
+// #include <atomic>
+// #include <mutex>
+// #include <memory>
+// #include <vector>
+// #include <iostream>
+// #include <functional>
+// #include <math.h>
+// #include <limits>
+// #include <algorithm>
+// #include <iterator>
+// #include <assert.h>
+// #include "histogram.h"
+// #include "atomic_histogram.h"
+
+// Gives every recording thread a private AtomicHistogram shard, so that hot
+// sub-buckets are never shared between cores and each record costs what a
+// single-writer histogram costs.  A thread's shard is created the first time
+// it records and outlives the thread; snapshot() merges all the shards.
+//
+// Only its owner ever writes to a shard: reset() moves on an epoch, and each
+// owner clears its shard when it next records.  Until then the shard's
+// contents are from before the reset and snapshot() leaves them out.
+class StripedHistogram final
+{
+
+public:
+
+    StripedHistogram(int64_t highestTrackableValue,
+                     int64_t numberOfSignificantValueDigits);
+    ~StripedHistogram();
+
+    StripedHistogram(const StripedHistogram&) = delete;
+    StripedHistogram& operator=(const StripedHistogram&) = delete;
+
+    int64_t getHighestTrackableValue() const;
+    int64_t getNumberOfSignificantValueDigits() const;
+    size_t getShardCount() const;
+
+    void recordValue(int64_t value);
+
+    // Replaces the contents of target, which must have the same
+    // configuration, with the sum of all the shards.  Taken while threads
+    // record, it is approximate: each shard is read a count at a time, but
+    // target's total count always agrees with the counts it holds.
+    void snapshot(AtomicHistogram& target) const;
+    // Values recorded while the reset is under way may or may not survive it.
+    void reset();
+
+private:
+    struct Shard;
+
+    const uint64_t id;
+    // Expires with the instance, so threads can drop their cached shards.
+    const std::shared_ptr< const uint64_t > handle;
+    const int64_t highestTrackableValue;
+    const int64_t numberOfSignificantValueDigits;
+    std::atomic< uint64_t > resetEpoch;
+    mutable std::mutex shardsMutex;
+    std::vector< std::unique_ptr< Shard > > shards;
+
+    Shard& localShard();
+    Shard& registerShard();
+
+    friend struct LocalShard;
+    friend struct LocalShardCache;
+
+};
@@ -0,0 +1,75 @@
+#include <stdint.h>
+#include <assert.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <limits>
+
+#include "writer_reader_phaser.h"
+
+// The sign of startEpoch tells a writer which phase it entered in: even
+// phases count up from zero, odd phases count up from INT64_MIN.
+static const int64_t ODD_PHASE_START = std::numeric_limits< int64_t >::min();
+
+WriterReaderPhaser::WriterReaderPhaser() :
+    startEpoch{ 0 },
+    evenEndEpoch{ 0 },
+    oddEndEpoch{ ODD_PHASE_START }
+{
+}
+
+WriterReaderPhaser::~WriterReaderPhaser()
+{
+}
+
+int64_t WriterReaderPhaser::writerCriticalSectionEnter()
+{
+    return startEpoch.fetch_add(1);
+}
+
+void WriterReaderPhaser::writerCriticalSectionExit(int64_t criticalValueAtEnter)
+{
+    if (criticalValueAtEnter < 0)
+    {
+        oddEndEpoch.fetch_add(1);
+    }
+    else
+    {
+        evenEndEpoch.fetch_add(1);
+    }
+}
+
+void WriterReaderPhaser::readerLock()
+{
+    readerMutex.lock();
+}
+
+void WriterReaderPhaser::readerUnlock()
+{
+    readerMutex.unlock();
+}
+
+void WriterReaderPhaser::flipPhase()
+{
+    bool nextPhaseIsEven = startEpoch.load() < 0;
+
+    int64_t initialStartValue = nextPhaseIsEven ? 0 : ODD_PHASE_START;
+    if (nextPhaseIsEven)
+    {
+        evenEndEpoch.store(initialStartValue);
+    }
+    else
+    {
+        oddEndEpoch.store(initialStartValue);
+    }
+
+    int64_t startValueAtFlip = startEpoch.exchange(initialStartValue);
+
+    // Wait for every writer that entered during the phase just closed to exit.
+    std::atomic< int64_t >& previousEndEpoch = nextPhaseIsEven ? oddEndEpoch : evenEndEpoch;
+    while (previousEndEpoch.load() != startValueAtFlip)
+    {
+        std::this_thread::yield();
+    }
+}
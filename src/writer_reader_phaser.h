@@ -0,0 +1,37 @@
+
+// Required includes
+// #include <stdint.h>
+// #include <atomic>
+// #include <mutex>
+
+// Lets a single reader safely swap out data that is being updated by any
+// number of writers, without the writers ever blocking.  Writers bracket each
+// update with writerCriticalSectionEnter/Exit (two wait-free atomic adds); the
+// reader, holding readerLock, changes the data pointer the writers use and then
+// calls flipPhase, which returns once every writer that might still have seen
+// the old pointer has left its critical section.
+class WriterReaderPhaser final
+{
+
+public:
+
+    WriterReaderPhaser();
+    ~WriterReaderPhaser();
+
+    WriterReaderPhaser(const WriterReaderPhaser&) = delete;
+    WriterReaderPhaser& operator=(const WriterReaderPhaser&) = delete;
+
+    int64_t writerCriticalSectionEnter();
+    void writerCriticalSectionExit(int64_t criticalValueAtEnter);
+
+    void readerLock();
+    void readerUnlock();
+    void flipPhase();
+
+private:
+    std::atomic< int64_t > startEpoch;
+    std::atomic< int64_t > evenEndEpoch;
+    std::atomic< int64_t > oddEndEpoch;
+    std::mutex readerMutex;
+
+};
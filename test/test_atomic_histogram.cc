@@ -0,0 +1,93 @@
+#include <iostream>
+#include <vector>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <iterator>
+#include <limits>
+#include <algorithm>
+#include <assert.h>
+#include <stdint.h>
+#include <math.h>
+#include <UnitTest++.h>
+#include <histogram.h>
+#include <atomic_histogram.h>
+
+TEST(AtomicShouldRecordValue)
+{
+    int64_t testValue = 4;
+    AtomicHistogram h{ 100000000, 3 };
+
+    h.recordValue(testValue);
+    CHECK_EQUAL(1, h.getCountAtValue(testValue));
+    CHECK_EQUAL(1, h.getTotalCount());
+}
+
+TEST(AtomicShouldMatchHistogramQueries)
+{
+    AtomicHistogram histogram{ 3600000000, 3 };
+    for (int i = 0; i < 10000; i++)
+    {
+        histogram.recordValue(1000L, 10000L);
+    }
+    histogram.recordValue(100000000L, 10000L);
+
+    CHECK_EQUAL(20000, histogram.getTotalCount());
+    CHECK(histogram.valuesAreEquivalent(100000000L, histogram.getMaxValue()));
+    CHECK(histogram.valuesAreEquivalent(1000L, histogram.getMinValue()));
+    CHECK_CLOSE(50000000.0, (double) histogram.getValueAtPercentile(75.0), 50000000.0 * 0.001);
+    CHECK_CLOSE(50.0, histogram.getPercentileAtOrBelowValue(5000), 0.0001);
+    CHECK_EQUAL(10000, histogram.getCountBetweenValues(5000L, 150000000L));
+
+    // The queries are Histogram's own, over the same layout.
+    Histogram expected{ 3600000000, 3 };
+    for (int i = 0; i < 10000; i++)
+    {
+        expected.recordValue(1000L, 10000L);
+    }
+    expected.recordValue(100000000L, 10000L);
+    CHECK_EQUAL(expected.getMaxValue(), histogram.getMaxValue());
+    CHECK_EQUAL(expected.getValueAtPercentile(99.9), histogram.getValueAtPercentile(99.9));
+    CHECK_CLOSE(expected.getMeanValue(), histogram.getMeanValue(), 0.001);
+    CHECK_CLOSE(expected.getStdDeviation(), histogram.getStdDeviation(), 0.001);
+}
+
+TEST(AtomicShouldRecordFromManyThreads)
+{
+    const int threadCount = 8;
+    const int valuesPerThread = 100000;
+    AtomicHistogram histogram{ 3600000000, 3 };
+
+    std::vector< std::thread > threads;
+    for (int t = 0; t < threadCount; t++)
+    {
+        threads.emplace_back([&histogram, t] ()
+        {
+            for (int i = 0; i < valuesPerThread; i++)
+            {
+                histogram.recordValue(1000L * (t + 1));
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    CHECK_EQUAL(threadCount * valuesPerThread, histogram.getTotalCount());
+    for (int t = 0; t < threadCount; t++)
+    {
+        CHECK_EQUAL(valuesPerThread, histogram.getCountAtValue(1000L * (t + 1)));
+    }
+}
+
+TEST(AtomicShouldReset)
+{
+    AtomicHistogram histogram{ 3600000000, 3 };
+    histogram.recordValue(1000L);
+    histogram.reset();
+
+    CHECK_EQUAL(0, histogram.getTotalCount());
+    CHECK_EQUAL(0, histogram.getCountAtValue(1000L));
+}
@@ -0,0 +1,78 @@
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <algorithm>
+#include <assert.h>
+#include <math.h>
+#include <UnitTest++.h>
+#include <histogram.h>
+#include <double_histogram.h>
+
+TEST(DoubleShouldRecordValue)
+{
+    DoubleHistogram histogram{ 1000000000000L, 3 };
+
+    histogram.recordValue(4.5);
+    CHECK_EQUAL(1, histogram.getCountAtValue(4.5));
+    CHECK_EQUAL(1, histogram.getTotalCount());
+    CHECK_CLOSE(4.5, histogram.getMaxValue(), 4.5 * 0.001);
+    CHECK(histogram.getCurrentLowestTrackableNonZeroValue() <= 4.5);
+    CHECK(histogram.getCurrentHighestTrackableValue() >= 4.5 * 1000000000000.0);
+}
+
+TEST(DoubleShouldAutoRangeInBothDirections)
+{
+    DoubleHistogram histogram{ 1000000000000L, 3 };
+
+    histogram.recordValue(1.0);
+    histogram.recordValueWithCount(1000.0, 10);
+    histogram.recordValue(0.000001);
+    histogram.recordValue(0.0);
+    histogram.recordValue(250000.0);
+
+    CHECK_EQUAL(14, histogram.getTotalCount());
+    CHECK_EQUAL(1, histogram.getCountAtValue(1.0));
+    CHECK_EQUAL(10, histogram.getCountAtValue(1000.0));
+    CHECK_EQUAL(1, histogram.getCountAtValue(0.000001));
+    CHECK_EQUAL(1, histogram.getCountAtValue(0.0));
+    CHECK_EQUAL(1, histogram.getCountAtValue(250000.0));
+
+    CHECK(histogram.valuesAreEquivalent(250000.0, histogram.getMaxValue()));
+    CHECK_EQUAL(0.0, histogram.getMinValue());
+    CHECK(histogram.valuesAreEquivalent(1000.0, histogram.getValueAtPercentile(50.0)));
+    CHECK(histogram.valuesAreEquivalent(0.000001, histogram.getValueAtPercentile(12.0)));
+    CHECK_EQUAL(11, histogram.getCountBetweenValues(0.5, 2000.0));
+}
+
+TEST(DoubleShouldKeepPrecisionAcrossRange)
+{
+    DoubleHistogram histogram{ 1000000000L, 3 };
+
+    for (double value = 0.001; value < 1000000.0; value *= 1.37)
+    {
+        histogram.recordValue(value);
+        CHECK(histogram.sizeOfEquivalentRange(value) <= value * 0.001);
+        CHECK_EQUAL(1, histogram.getCountAtValue(value));
+    }
+}
+
+TEST(DoubleShouldRejectValuesBeyondRatio)
+{
+    DoubleHistogram histogram{ 1000L, 3 };
+
+    CHECK(histogram.recordValue(1.0));
+    CHECK(histogram.recordValue(100.0));
+    CHECK(!histogram.recordValue(10000000.0));
+    CHECK(!histogram.recordValue(0.00001));
+    CHECK(histogram.recordValue(0.0));
+    CHECK(!histogram.recordValue(-1.0));
+    CHECK(!histogram.recordValue(std::numeric_limits< double >::infinity()));
+    CHECK(!histogram.recordValueWithCount(std::numeric_limits< double >::quiet_NaN(), 2));
+
+    CHECK_EQUAL(3, histogram.getTotalCount());
+    CHECK(histogram.valuesAreEquivalent(100.0, histogram.getMaxValue()));
+    CHECK_EQUAL(1, histogram.getCountAtValue(1.0));
+}
@@ -1,6 +1,14 @@
 #include <iostream>
+#include <memory>
 #include <vector>
 #include <functional>
+#include <iterator>
+#include <limits>
+#include <algorithm>
+#include <assert.h>
+#include <stdint.h>
+#include <math.h>
+#include <zlib.h>
 #include <UnitTest++.h>
 #include <histogram.h>
 
@@ -156,3 +164,951 @@ TEST(ShouldHandleAllPercentiles)
     histogram.outputPercentileValues(std::cout, 5, 1.0);
 }
 
+
+TEST(ShouldRecordValuesInBatch)
+{
+    Histogram single{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    Histogram batched{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+
+    // Spread values over every bucket, with a length that leaves a scalar tail.
+    std::vector<int64_t> values;
+    uint64_t seed = 42;
+    for (int i = 0; i < 1003; i++)
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        values.push_back((int64_t) ((seed >> 11) % (uint64_t) (HIGHEST_TRACKABLE_VALUE >> (i % 32))));
+    }
+    values.push_back(0);
+    values.push_back(HIGHEST_TRACKABLE_VALUE);
+
+    for (auto value : values)
+    {
+        single.recordValue(value);
+    }
+    batched.recordValues(values.data(), values.size());
+
+    CHECK_EQUAL(single.getTotalCount(), batched.getTotalCount());
+    for (auto value : values)
+    {
+        CHECK_EQUAL(single.getCountAtValue(value), batched.getCountAtValue(value));
+    }
+}
+
+TEST(ShouldRecordValuesWithCountsInBatch)
+{
+    Histogram histogram{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+
+    int64_t values[] = { 1000L, 2000L, 1000L, 100000000L, 5L };
+    int64_t counts[] = { 10,    20,    30,    1,          0 };
+    histogram.recordValuesWithCounts(values, counts, 5);
+
+    CHECK_EQUAL(61, histogram.getTotalCount());
+    CHECK_EQUAL(40, histogram.getCountAtValue(1000L));
+    CHECK_EQUAL(20, histogram.getCountAtValue(2000L));
+    CHECK_EQUAL(1,  histogram.getCountAtValue(100000000L));
+    CHECK_EQUAL(0,  histogram.getCountAtValue(5L));
+}
+
+TEST(ShouldUseNarrowCounts)
+{
+    Histogram histogram{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    IntCountsHistogram intHistogram{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    ShortCountsHistogram shortHistogram{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+
+    CHECK_EQUAL(8, histogram.getCountsWordSize());
+    CHECK_EQUAL(4, intHistogram.getCountsWordSize());
+    CHECK_EQUAL(2, shortHistogram.getCountsWordSize());
+    CHECK(shortHistogram.getEstimatedFootprintInBytes() * 3 < histogram.getEstimatedFootprintInBytes());
+
+    for (int i = 0; i < 10000; i++)
+    {
+        shortHistogram.recordValue(1000L, 10000L);
+    }
+    shortHistogram.recordValue(100000000L, 10000L);
+
+    CHECK_EQUAL(20000, shortHistogram.getTotalCount());
+    CHECK_CLOSE(50000000.0, (double) shortHistogram.getValueAtPercentile(75.0), 50000000.0 * 0.001);
+}
+
+TEST(ShouldPromoteCountsOnOverflow)
+{
+    AutoPromotingHistogram histogram{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    CHECK_EQUAL(2, histogram.getCountsWordSize());
+
+    for (int i = 0; i < 32767; i++)
+    {
+        histogram.recordValue(1000L);
+    }
+    histogram.recordValue(2000L);
+    CHECK_EQUAL(2, histogram.getCountsWordSize());
+
+    histogram.recordValue(1000L);
+    CHECK_EQUAL(4, histogram.getCountsWordSize());
+    CHECK_EQUAL(32768, histogram.getCountAtValue(1000L));
+    CHECK_EQUAL(1, histogram.getCountAtValue(2000L));
+
+    int64_t values[] = { 1000L };
+    int64_t counts[] = { 3000000000L };
+    histogram.recordValuesWithCounts(values, counts, 1);
+    CHECK_EQUAL(8, histogram.getCountsWordSize());
+    CHECK_EQUAL(3000032768L, histogram.getCountAtValue(1000L));
+    CHECK_EQUAL(3000032769L, histogram.getTotalCount());
+}
+
+TEST(ShouldPackSparseCounts)
+{
+    Histogram dense{ HIGHEST_TRACKABLE_VALUE, 5 };
+    PackedHistogram packed{ HIGHEST_TRACKABLE_VALUE, 5 };
+
+    for (int64_t value = 1000; value < 2000; value += 10)
+    {
+        packed.recordValue(value);
+    }
+    CHECK(packed.getEstimatedFootprintInBytes() * 50 < dense.getEstimatedFootprintInBytes());
+
+    packed.reset();
+    for (int i = 0; i < 10000; i++)
+    {
+        dense.recordValue(1000L, 10000L);
+        packed.recordValue(1000L, 10000L);
+    }
+    dense.recordValue(100000000L, 10000L);
+    packed.recordValue(100000000L, 10000L);
+
+    CHECK_EQUAL(dense.getTotalCount(), packed.getTotalCount());
+    CHECK_EQUAL(dense.getCountAtValue(1000L), packed.getCountAtValue(1000L));
+    CHECK_EQUAL(dense.getMaxValue(), packed.getMaxValue());
+    CHECK_EQUAL(dense.getMinValue(), packed.getMinValue());
+    CHECK_EQUAL(dense.getValueAtPercentile(90.0), packed.getValueAtPercentile(90.0));
+    CHECK_EQUAL(dense.getCountBetweenValues(5000L, 150000000L), packed.getCountBetweenValues(5000L, 150000000L));
+    CHECK_CLOSE(dense.getPercentileAtOrBelowValue(5000), packed.getPercentileAtOrBelowValue(5000), 0.0001);
+}
+
+TEST(ShouldTrackStatisticsWhileRecording)
+{
+    Histogram tracked{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    Histogram scanned{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    Histogram trackedCorrected{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    Histogram scannedCorrected{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    scanned.setStatisticsTracking(false);
+    scannedCorrected.setStatisticsTracking(false);
+    loadHistograms(tracked, trackedCorrected);
+    loadHistograms(scanned, scannedCorrected);
+
+    CHECK(tracked.isStatisticsTracking());
+    CHECK(!scanned.isStatisticsTracking());
+
+    CHECK_EQUAL(scanned.getMaxValue(), tracked.getMaxValue());
+    CHECK_EQUAL(scanned.getMinValue(), tracked.getMinValue());
+    CHECK_CLOSE(scanned.getMeanValue(), tracked.getMeanValue(), 0.001);
+    CHECK_CLOSE(scanned.getStdDeviation(), tracked.getStdDeviation(), 1.0);
+    CHECK_EQUAL(scannedCorrected.getMaxValue(), trackedCorrected.getMaxValue());
+    CHECK_EQUAL(scannedCorrected.getMinValue(), trackedCorrected.getMinValue());
+    CHECK_CLOSE(scannedCorrected.getMeanValue(), trackedCorrected.getMeanValue(), 0.001);
+    CHECK_CLOSE(scannedCorrected.getStdDeviation(), trackedCorrected.getStdDeviation(), 1.0);
+
+    // Uniform 1..10000: mean 5000.5, population stddev ~2886.75.
+    Histogram uniform{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    for (int64_t value = 1; value <= 10000; value++)
+    {
+        uniform.recordValue(value);
+    }
+    CHECK_CLOSE(5000.5, uniform.getMeanValue(), 5000.5 * 0.001);
+    CHECK_CLOSE(2886.75, uniform.getStdDeviation(), 2886.75 * 0.001);
+
+    uniform.setStatisticsTracking(false);
+    double scannedStdDeviation = uniform.getStdDeviation();
+    uniform.setStatisticsTracking(true);
+    CHECK_CLOSE(scannedStdDeviation, uniform.getStdDeviation(), 0.01);
+
+    uniform.reset();
+    CHECK_EQUAL(0, uniform.getMaxValue());
+    CHECK_EQUAL(0, uniform.getMinValue());
+}
+
+TEST(ShouldAnswerRankQueriesFromIndex)
+{
+    Histogram scanned{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    Histogram indexed{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    Histogram indexedLater{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    indexed.setRankIndexing(true);
+    CHECK(indexed.isRankIndexing());
+    CHECK(!scanned.isRankIndexing());
+
+    uint64_t seed = 7;
+    for (int i = 0; i < 20000; i++)
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        int64_t value = (int64_t) ((seed >> 33) % 200000000ULL);
+        scanned.recordValue(value, 10000000L);
+        indexed.recordValue(value, 10000000L);
+        indexedLater.recordValue(value, 10000000L);
+    }
+    indexedLater.setRankIndexing(true);
+
+    const double percentiles[] = { 0.0, 1.0, 25.0, 50.0, 90.0, 99.0, 99.9, 99.999, 100.0 };
+    for (auto percentile : percentiles)
+    {
+        CHECK_EQUAL(scanned.getValueAtPercentile(percentile), indexed.getValueAtPercentile(percentile));
+        CHECK_EQUAL(scanned.getValueAtPercentile(percentile), indexedLater.getValueAtPercentile(percentile));
+    }
+
+    const int64_t values[] = { 0L, 1000L, 2047L, 2048L, 5000000L, 100000000L, 199999999L };
+    for (auto value : values)
+    {
+        CHECK_CLOSE(scanned.getPercentileAtOrBelowValue(value), indexed.getPercentileAtOrBelowValue(value), 0.000001);
+        CHECK_EQUAL(scanned.getCountBetweenValues(value, 150000000L), indexed.getCountBetweenValues(value, 150000000L));
+        CHECK_EQUAL(scanned.getCountBetweenValues(0L, value), indexed.getCountBetweenValues(0L, value));
+    }
+
+    indexed.reset();
+    indexed.recordValue(1000L);
+    CHECK_EQUAL(1000L, indexed.getValueAtPercentile(50.0));
+    CHECK_EQUAL(1, indexed.getCountBetweenValues(0L, 5000L));
+}
+
+TEST(ShouldGetValuesAtManyPercentilesInOnePass)
+{
+    Histogram histogram{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    Histogram histogramCorrected{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    loadHistograms(histogram, histogramCorrected);
+
+    const double percentiles[] = { 99.999, 50.0, 90.0, 0.0, 99.0, 100.0, 75.0 };
+    const size_t length = sizeof(percentiles) / sizeof(percentiles[0]);
+    int64_t values[length];
+
+    histogramCorrected.getValuesAtPercentiles(percentiles, length, values);
+    for (size_t i = 0; i < length; i++)
+    {
+        CHECK_EQUAL(histogramCorrected.getValueAtPercentile(percentiles[i]), values[i]);
+    }
+
+    HistogramSummary summary;
+    histogramCorrected.setStatisticsTracking(false);
+    histogramCorrected.getPercentileSummary(percentiles, length, values, summary);
+    for (size_t i = 0; i < length; i++)
+    {
+        CHECK_EQUAL(histogramCorrected.getValueAtPercentile(percentiles[i]), values[i]);
+    }
+    CHECK_EQUAL(20000, summary.totalCount);
+    CHECK_EQUAL(histogramCorrected.getMinValue(), summary.minValue);
+    CHECK_EQUAL(histogramCorrected.getMaxValue(), summary.maxValue);
+    CHECK_CLOSE(histogramCorrected.getMeanValue(), summary.meanValue, 0.001);
+}
+
+TEST(ShouldCorrectForCoordinatedOmissionLikeRecordingEachValue)
+{
+    Histogram looped{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    Histogram corrected{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+
+    const int64_t intervals[] = { 1L, 7L, 1000L, 10000L, 123457L };
+    uint64_t seed = 11;
+    for (int i = 0; i < 200; i++)
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        int64_t expectedInterval = intervals[i % 5];
+        int64_t value = (int64_t) ((seed >> 33) % (uint64_t) (expectedInterval * 2000));
+
+        looped.recordValue(value);
+        for (int64_t missingValue = value - expectedInterval; missingValue >= expectedInterval; missingValue -= expectedInterval)
+        {
+            looped.recordValue(missingValue);
+        }
+        corrected.recordValue(value, expectedInterval);
+    }
+
+    CHECK_EQUAL(looped.getTotalCount(), corrected.getTotalCount());
+    int64_t mismatches = 0;
+    looped.forAll([&] (int64_t value, int64_t count)
+    {
+        mismatches += (count != corrected.getCountAtValue(value)) ? 1 : 0;
+    });
+    CHECK_EQUAL(0, mismatches);
+    CHECK_EQUAL(looped.getMaxValue(), corrected.getMaxValue());
+    CHECK_EQUAL(looped.getMinValue(), corrected.getMinValue());
+    CHECK_CLOSE(looped.getMeanValue(), corrected.getMeanValue(), 0.000001);
+}
+
+TEST(ShouldCorrectForCoordinatedOmissionAfterRecording)
+{
+    Histogram histogram{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    Histogram histogramCorrected{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    loadHistograms(histogram, histogramCorrected);
+
+    Histogram postCorrected = histogram.copyCorrectedForCoordinatedOmission(10000L);
+
+    CHECK_EQUAL(histogramCorrected.getTotalCount(), postCorrected.getTotalCount());
+    CHECK_EQUAL(histogramCorrected.getCountAtValue(1000L), postCorrected.getCountAtValue(1000L));
+    CHECK_CLOSE((double) histogramCorrected.getValueAtPercentile(75.0),
+                (double) postCorrected.getValueAtPercentile(75.0), 50000000.0 * 0.001);
+    CHECK_CLOSE((double) histogramCorrected.getValueAtPercentile(99.0),
+                (double) postCorrected.getValueAtPercentile(99.0), 98000000.0 * 0.001);
+    CHECK_CLOSE(histogramCorrected.getMeanValue(), postCorrected.getMeanValue(),
+                histogramCorrected.getMeanValue() * 0.001);
+
+    Histogram accumulated{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    accumulated.addWhileCorrectingForCoordinatedOmission(histogram, 10000L);
+    accumulated.addWhileCorrectingForCoordinatedOmission(histogram, 10000L);
+    CHECK_EQUAL(2 * postCorrected.getTotalCount(), accumulated.getTotalCount());
+    CHECK_EQUAL(2 * postCorrected.getCountAtValue(50000000L), accumulated.getCountAtValue(50000000L));
+}
+
+TEST(ShouldRecordValueWithCount)
+{
+    Histogram histogram{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    Histogram looped{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+
+    histogram.recordValueWithCount(1200000L, 4000);
+    histogram.recordValueWithCount(5000L, 0);
+    histogram.recordValueWithCount(1000L, 1);
+    for (int i = 0; i < 4000; i++)
+    {
+        looped.recordValue(1200000L);
+    }
+    looped.recordValue(1000L);
+
+    CHECK_EQUAL(4001, histogram.getTotalCount());
+    CHECK_EQUAL(4000, histogram.getCountAtValue(1200000L));
+    CHECK_EQUAL(0, histogram.getCountAtValue(5000L));
+    CHECK_EQUAL(looped.getMinValue(), histogram.getMinValue());
+    CHECK_EQUAL(looped.getMaxValue(), histogram.getMaxValue());
+    CHECK_CLOSE(looped.getMeanValue(), histogram.getMeanValue(), 0.000001);
+    CHECK_CLOSE(looped.getStdDeviation(), histogram.getStdDeviation(), 0.001);
+}
+
+TEST(ShouldAutoResizeToFitValues)
+{
+    Histogram histogram{ 2, SIGNIFICANT_DIGITS };
+    histogram.setAutoResize(true);
+    histogram.setRankIndexing(true);
+    CHECK(histogram.isAutoResize());
+
+    histogram.recordValue(1000L);
+    histogram.recordValue(1L << 30);
+    CHECK(histogram.getHighestTrackableValue() >= (1L << 30));
+    CHECK_EQUAL(1, histogram.getCountAtValue(1000L));
+    CHECK_EQUAL(1, histogram.getCountAtValue(1L << 30));
+
+    int64_t values[] = { 5000L, 1L << 40 };
+    histogram.recordValues(values, 2);
+    histogram.recordValueWithCount(1L << 45, 3);
+    histogram.recordValue(1L << 50, 1L << 48);
+
+    CHECK(histogram.getHighestTrackableValue() >= (1L << 50));
+    CHECK_EQUAL(11, histogram.getTotalCount());
+    CHECK_EQUAL(1, histogram.getCountAtValue(1L << 40));
+    CHECK_EQUAL(3, histogram.getCountAtValue(1L << 45));
+    CHECK(histogram.valuesAreEquivalent(1L << 50, histogram.getMaxValue()));
+    CHECK(histogram.valuesAreEquivalent(1000L, histogram.getMinValue()));
+    CHECK(histogram.valuesAreEquivalent(1L << 45, histogram.getValueAtPercentile(50.0)));
+    CHECK_EQUAL(4, histogram.getCountBetweenValues(1L << 40, 1L << 47));
+}
+
+TEST(ShouldMoveRatherThanCopyCounts)
+{
+    Histogram histogram{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    histogram.recordValue(1000L);
+    auto footprint = histogram.getEstimatedFootprintInBytes();
+
+    Histogram moved{ std::move(histogram) };
+    CHECK_EQUAL(1, moved.getCountAtValue(1000L));
+    CHECK(histogram.getEstimatedFootprintInBytes() < footprint);
+
+    Histogram assigned{ 2, SIGNIFICANT_DIGITS };
+    assigned = std::move(moved);
+    CHECK_EQUAL(1, assigned.getCountAtValue(1000L));
+    CHECK(moved.getEstimatedFootprintInBytes() < footprint);
+}
+
+TEST(ShouldAutoResizeBatchesWithRankIndexing)
+{
+    Histogram histogram{ 2, SIGNIFICANT_DIGITS };
+    histogram.setAutoResize(true);
+    histogram.setRankIndexing(true);
+
+    // The last value of the batch forces a resize after the others are known.
+    int64_t values[] = { 1000L, 2000L, 1L << 40 };
+    histogram.recordValues(values, 3);
+    CHECK_EQUAL(3, histogram.getTotalCount());
+    CHECK_EQUAL(3, histogram.getCountBetweenValues(0L, 1L << 40));
+    CHECK_CLOSE(100.0 / 3, histogram.getPercentileAtOrBelowValue(1500L), 0.000001);
+    CHECK_EQUAL(2000L, histogram.getValueAtPercentile(50.0));
+
+    int64_t counts[] = { 2, 1 };
+    int64_t weighted[] = { 3000L, 1L << 45 };
+    histogram.recordValuesWithCounts(weighted, counts, 2);
+    CHECK_EQUAL(6, histogram.getTotalCount());
+    CHECK_EQUAL(6, histogram.getCountBetweenValues(0L, 1L << 45));
+}
+
+TEST(ShouldShrinkCountsWithLowestDiscernibleValue)
+{
+    Histogram fine{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    Histogram coarse{ 1000, HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    Histogram batched{ 1000, HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+
+    CHECK_EQUAL(1, fine.getLowestDiscernibleValue());
+    CHECK_EQUAL(1000, coarse.getLowestDiscernibleValue());
+    CHECK(coarse.getEstimatedFootprintInBytes() * 3 < fine.getEstimatedFootprintInBytes() * 2);
+
+    std::vector<int64_t> values;
+    for (int64_t value = 0; value < HIGHEST_TRACKABLE_VALUE; value = value * 3 + 7)
+    {
+        values.push_back(value);
+        fine.recordValue(value);
+        coarse.recordValue(value);
+    }
+    batched.recordValues(values.data(), values.size());
+
+    // Values below the unit share a single count.
+    CHECK(coarse.valuesAreEquivalent(7, 500));
+    CHECK_EQUAL(512, coarse.sizeOfEquivalentRange(7));
+    CHECK(!fine.valuesAreEquivalent(7, 500));
+
+    for (auto value : values)
+    {
+        CHECK_EQUAL(coarse.getCountAtValue(value), batched.getCountAtValue(value));
+    }
+    CHECK_EQUAL(fine.getTotalCount(), coarse.getTotalCount());
+    CHECK_CLOSE((double) fine.getValueAtPercentile(90.0), (double) coarse.getValueAtPercentile(90.0),
+                fine.getValueAtPercentile(90.0) * 0.001);
+    CHECK_CLOSE((double) fine.getMaxValue(), (double) coarse.getMaxValue(), fine.getMaxValue() * 0.001);
+    CHECK_CLOSE(fine.getMeanValue(), coarse.getMeanValue(), fine.getMeanValue() * 0.001);
+}
+
+TEST(ShouldAddAndSubtractHistograms)
+{
+    Histogram histogram{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    Histogram histogramCorrected{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    loadHistograms(histogram, histogramCorrected);
+
+    Histogram sum{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    sum.add(histogram);
+    sum.add(histogramCorrected);
+
+    CHECK_EQUAL(30001, sum.getTotalCount());
+    CHECK_EQUAL(20000, sum.getCountAtValue(1000L));
+    CHECK_EQUAL(histogram.getCountAtValue(100000000L) + histogramCorrected.getCountAtValue(100000000L),
+                sum.getCountAtValue(100000000L));
+    CHECK_EQUAL(histogramCorrected.getMaxValue(), sum.getMaxValue());
+    CHECK_EQUAL(histogram.getMinValue(), sum.getMinValue());
+
+    sum.subtract(histogramCorrected);
+    CHECK_EQUAL(histogram.getTotalCount(), sum.getTotalCount());
+    CHECK_EQUAL(histogram.getCountAtValue(1000L), sum.getCountAtValue(1000L));
+    CHECK_EQUAL(histogram.getMaxValue(), sum.getMaxValue());
+    CHECK_CLOSE(histogram.getMeanValue(), sum.getMeanValue(), 0.001);
+    CHECK_EQUAL(0, sum.getCountBetweenValues(10000L, 90000000L));
+
+    // Taking away more than is held changes nothing, whatever the layout.
+    Histogram held{ histogram };
+    CHECK(!held.subtract(histogramCorrected));
+    CHECK_EQUAL(histogram.getTotalCount(), held.getTotalCount());
+    CHECK_EQUAL(histogram.getCountAtValue(1000L), held.getCountAtValue(1000L));
+    CHECK_EQUAL(histogram.getMaxValue(), held.getMaxValue());
+
+    // 3000 and 3001 share a bucket here but not in the finer layout.
+    held.recordValueWithCount(3000L, 10);
+    Histogram fine{ 1, HIGHEST_TRACKABLE_VALUE, 4 };
+    fine.recordValueWithCount(3000L, 6);
+    fine.recordValueWithCount(3001L, 6);
+    CHECK(!held.subtract(fine));
+    CHECK_EQUAL(10, held.getCountAtValue(3000L));
+    fine.reset();
+    fine.recordValueWithCount(3000L, 5);
+    fine.recordValueWithCount(3001L, 5);
+    CHECK(held.subtract(fine));
+    CHECK_EQUAL(0, held.getCountAtValue(3000L));
+    CHECK_EQUAL(histogram.getTotalCount(), held.getTotalCount());
+}
+
+TEST(ShouldAddHistogramsWithDifferentLayouts)
+{
+    Histogram histogram{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    Histogram histogramCorrected{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    loadHistograms(histogram, histogramCorrected);
+
+    Histogram smaller{ 1000000, SIGNIFICANT_DIGITS };
+    smaller.recordValue(1000L);
+    Histogram larger{ HIGHEST_TRACKABLE_VALUE * 16, SIGNIFICANT_DIGITS };
+    larger.add(histogramCorrected);
+    larger.add(smaller);
+    CHECK_EQUAL(20001, larger.getTotalCount());
+    CHECK_EQUAL(10001, larger.getCountAtValue(1000L));
+
+    Histogram coarse{ 1000, HIGHEST_TRACKABLE_VALUE, 2 };
+    coarse.add(histogram);
+    CHECK_EQUAL(histogram.getTotalCount(), coarse.getTotalCount());
+    CHECK(coarse.valuesAreEquivalent(100000000L, coarse.getMaxValue()));
+
+    Histogram growing{ 1000000, SIGNIFICANT_DIGITS };
+    growing.setAutoResize(true);
+    growing.add(histogram);
+    CHECK_EQUAL(histogram.getTotalCount(), growing.getTotalCount());
+    CHECK_EQUAL(histogram.getMaxValue(), growing.getMaxValue());
+
+    // Values beyond a fixed range are refused rather than written past it.
+    Histogram narrow{ 1000000, SIGNIFICANT_DIGITS };
+    narrow.recordValue(1000L);
+    CHECK(!narrow.add(histogramCorrected));
+    CHECK(!narrow.subtract(larger));
+    CHECK_EQUAL(1, narrow.getTotalCount());
+    CHECK(narrow.add(smaller));
+    CHECK_EQUAL(2, narrow.getCountAtValue(1000L));
+
+    std::vector< const Histogram* > inputs{ &smaller, &histogram };
+    CHECK(!mergeAll(inputs.data(), inputs.size(), narrow, 2));
+    CHECK_EQUAL(3, narrow.getTotalCount());
+
+    PackedHistogram packed{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    PackedHistogram packedOther{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    packedOther.recordValue(1000L, 10000L);
+    packed.add(packedOther);
+    packed.add(packedOther);
+    CHECK_EQUAL(2, packed.getCountAtValue(1000L));
+    CHECK_EQUAL(2 * packedOther.getTotalCount(), packed.getTotalCount());
+}
+
+TEST(ShouldMergeAllHistogramsInParallel)
+{
+    std::vector< Histogram > histograms;
+    for (int i = 0; i < 200; i++)
+    {
+        histograms.emplace_back(HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS);
+        for (int64_t value = 1; value < 100000000L; value = value * 3 + i)
+        {
+            histograms.back().recordValue(value);
+        }
+    }
+    histograms.emplace_back(1000, HIGHEST_TRACKABLE_VALUE, 2);
+    histograms.back().recordValue(5000L);
+
+    std::vector< const Histogram* > inputs;
+    Histogram expected{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    for (auto& histogram : histograms)
+    {
+        inputs.push_back(&histogram);
+        expected.add(histogram);
+    }
+
+    for (unsigned threads : { 1u, 4u, 64u })
+    {
+        Histogram merged{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+        merged.setStatisticsTracking(true);
+        mergeAll(inputs.data(), inputs.size(), merged, threads);
+
+        CHECK_EQUAL(expected.getTotalCount(), merged.getTotalCount());
+        CHECK_EQUAL(expected.getMaxValue(), merged.getMaxValue());
+        CHECK_EQUAL(expected.getMinValue(), merged.getMinValue());
+        CHECK_CLOSE(expected.getMeanValue(), merged.getMeanValue(), 0.001);
+        CHECK_EQUAL(expected.getValueAtPercentile(99.0), merged.getValueAtPercentile(99.0));
+        CHECK_EQUAL(expected.getCountAtValue(5000L), merged.getCountAtValue(5000L));
+    }
+}
+
+TEST(ShouldEncodeV2CompressedFormat)
+{
+    Histogram histogram{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    histogram.recordValueWithCount(1, 3);
+    histogram.recordValueWithCount(1000, 2);
+
+    std::vector< uint8_t > buffer(histogram.getNeededByteBufferCapacity());
+    auto length = histogram.encodeIntoCompressedByteBuffer(buffer.data(), buffer.size());
+    CHECK(length > 8);
+    CHECK_EQUAL(0x1c, buffer[0]);
+    CHECK_EQUAL(0x84, buffer[1]);
+    CHECK_EQUAL(0x93, buffer[2]);
+    CHECK_EQUAL(0x14, buffer[3]);
+
+    // Header, then: one zero, 3, a run of 998 zeros, 2.
+    const uint8_t expected[] =
+    {
+        0x1c, 0x84, 0x93, 0x13, 0x00, 0x00, 0x00, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0xd6, 0x93, 0xa4, 0x00,
+        0x3f, 0xf0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x06, 0xcb, 0x0f, 0x04
+    };
+    uint8_t inflated[sizeof(expected) + 16];
+    uLongf inflatedLength = sizeof(inflated);
+    CHECK_EQUAL(Z_OK, uncompress(inflated, &inflatedLength, buffer.data() + 8, length - 8));
+    CHECK_EQUAL(sizeof(expected), inflatedLength);
+    CHECK_ARRAY_EQUAL(expected, inflated, sizeof(expected));
+
+    CHECK_EQUAL(0u, histogram.encodeIntoCompressedByteBuffer(buffer.data(), 12));
+}
+
+TEST(ShouldRoundTripV2CompressedEncoding)
+{
+    Histogram histogram{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    Histogram histogramCorrected{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    loadHistograms(histogram, histogramCorrected);
+    histogramCorrected.setStatisticsTracking(false);
+
+    std::vector< uint8_t > buffer(histogramCorrected.getNeededByteBufferCapacity());
+    auto length = histogramCorrected.encodeIntoCompressedByteBuffer(buffer.data(), buffer.size());
+    auto decoded = Histogram::decodeFromCompressedByteBuffer(buffer.data(), length);
+    CHECK(nullptr != decoded);
+
+    CHECK_EQUAL(histogramCorrected.getHighestTrackableValue(), decoded->getHighestTrackableValue());
+    CHECK_EQUAL(histogramCorrected.getNumberOfSignificantValueDigits(), decoded->getNumberOfSignificantValueDigits());
+    CHECK_EQUAL(histogramCorrected.getTotalCount(), decoded->getTotalCount());
+    CHECK_EQUAL(histogramCorrected.getMaxValue(), decoded->getMaxValue());
+    CHECK_EQUAL(histogramCorrected.getMinValue(), decoded->getMinValue());
+    CHECK_EQUAL(histogramCorrected.getValueAtPercentile(99.0), decoded->getValueAtPercentile(99.0));
+    CHECK_EQUAL(histogramCorrected.getCountBetweenValues(0, 50000000L),
+                decoded->getCountBetweenValues(0, 50000000L));
+
+    PackedHistogram packed{ 1000, HIGHEST_TRACKABLE_VALUE, 2 };
+    packed.recordValueWithCount(123456, 7);
+    packed.recordValueWithCount(98765432, 1);
+    std::vector< uint8_t > packedBuffer(packed.getNeededByteBufferCapacity());
+    length = packed.encodeIntoCompressedByteBuffer(packedBuffer.data(), packedBuffer.size());
+    auto packedDecoded = PackedHistogram::decodeFromCompressedByteBuffer(packedBuffer.data(), length,
+                                                                          HIGHEST_TRACKABLE_VALUE * 10);
+    CHECK(nullptr != packedDecoded);
+    CHECK_EQUAL(1000, packedDecoded->getLowestDiscernibleValue());
+    CHECK_EQUAL(HIGHEST_TRACKABLE_VALUE * 10, packedDecoded->getHighestTrackableValue());
+    CHECK_EQUAL(7, packedDecoded->getCountAtValue(123456));
+    CHECK_EQUAL(8, packedDecoded->getTotalCount());
+    CHECK_EQUAL(packed.getMaxValue(), packedDecoded->getMaxValue());
+
+    // Truncated or corrupted encodings are reported, not decoded.
+    length = histogramCorrected.encodeIntoCompressedByteBuffer(buffer.data(), buffer.size());
+    CHECK(nullptr == Histogram::decodeFromCompressedByteBuffer(buffer.data(), length / 2));
+    CHECK(nullptr == Histogram::decodeFromCompressedByteBuffer(buffer.data(), 4));
+    buffer[length - 6] ^= 0x5a;
+    CHECK(nullptr == Histogram::decodeFromCompressedByteBuffer(buffer.data(), length));
+    buffer[0] ^= 0xff;
+    CHECK(nullptr == Histogram::decodeFromCompressedByteBuffer(buffer.data(), length));
+}
+
+TEST(ShouldAddEncodedHistograms)
+{
+    Histogram histogram{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    Histogram histogramCorrected{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    loadHistograms(histogram, histogramCorrected);
+
+    std::vector< uint8_t > buffer(histogramCorrected.getNeededByteBufferCapacity());
+    auto length = histogramCorrected.encodeIntoCompressedByteBuffer(buffer.data(), buffer.size());
+
+    Histogram sum{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    sum.add(histogram);
+    CHECK(sum.addEncoded(buffer.data(), length));
+    CHECK(sum.addEncoded(buffer.data(), length));
+
+    Histogram expected{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    expected.add(histogram);
+    expected.add(histogramCorrected);
+    expected.add(histogramCorrected);
+    CHECK_EQUAL(expected.getTotalCount(), sum.getTotalCount());
+    CHECK_EQUAL(expected.getMaxValue(), sum.getMaxValue());
+    CHECK_EQUAL(expected.getValueAtPercentile(90.0), sum.getValueAtPercentile(90.0));
+    CHECK_CLOSE(expected.getMeanValue(), sum.getMeanValue(), 0.001);
+
+    Histogram coarse{ 1000, HIGHEST_TRACKABLE_VALUE, 2 };
+    CHECK(coarse.addEncoded(buffer.data(), length));
+    CHECK_EQUAL(histogramCorrected.getTotalCount(), coarse.getTotalCount());
+    CHECK(coarse.valuesAreEquivalent(histogramCorrected.getMaxValue(), coarse.getMaxValue()));
+
+    Histogram growing{ 1000000, SIGNIFICANT_DIGITS };
+    growing.setAutoResize(true);
+    CHECK(growing.addEncoded(buffer.data(), length));
+    CHECK_EQUAL(histogramCorrected.getTotalCount(), growing.getTotalCount());
+    CHECK_EQUAL(histogramCorrected.getMaxValue(), growing.getMaxValue());
+
+    // A wider range than ours: in the same layout and in a coarser one.
+    Histogram wide{ 3600000000000L, SIGNIFICANT_DIGITS };
+    wide.recordValue(3000000000000L);
+    std::vector< uint8_t > wideBuffer(wide.getNeededByteBufferCapacity());
+    auto wideLength = wide.encodeIntoCompressedByteBuffer(wideBuffer.data(), wideBuffer.size());
+    Histogram narrow{ 1000, SIGNIFICANT_DIGITS };
+    CHECK(!narrow.addEncoded(wideBuffer.data(), wideLength));
+    CHECK_EQUAL(0, narrow.getTotalCount());
+    Histogram narrowCoarse{ 10, 1000, 2 };
+    CHECK(!narrowCoarse.addEncoded(wideBuffer.data(), wideLength));
+    CHECK_EQUAL(0, narrowCoarse.getTotalCount());
+
+    Histogram untouched{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    CHECK(!untouched.addEncoded(buffer.data(), 4));
+    buffer[3] = 0;
+    CHECK(!untouched.addEncoded(buffer.data(), length));
+    CHECK_EQUAL(0, untouched.getTotalCount());
+}
+
+// histogram's V2 compressed encoding with its counts payload swapped for the
+// given bytes.
+std::vector< uint8_t > encodingWithPayload(const Histogram& histogram, const std::vector< uint8_t >& payload)
+{
+    std::vector< uint8_t > encoded(histogram.getNeededByteBufferCapacity());
+    auto length = histogram.encodeIntoCompressedByteBuffer(encoded.data(), encoded.size());
+
+    std::vector< uint8_t > plain(40);
+    uLongf plainLength = plain.size();
+    uncompress(plain.data(), &plainLength, encoded.data() + 8, length - 8);
+    plain.resize(40);
+    plain[4] = plain[5] = plain[6] = 0;
+    plain[7] = (uint8_t) payload.size();
+    plain.insert(plain.end(), payload.begin(), payload.end());
+
+    std::vector< uint8_t > crafted(8 + compressBound(plain.size()));
+    uLongf compressedLength = crafted.size() - 8;
+    compress(crafted.data() + 8, &compressedLength, plain.data(), plain.size());
+    std::copy(encoded.begin(), encoded.begin() + 4, crafted.begin());
+    for (int i = 0; i < 4; i++)
+    {
+        crafted[4 + i] = (uint8_t) (compressedLength >> (24 - 8 * i));
+    }
+    crafted.resize(8 + compressedLength);
+    return crafted;
+}
+
+TEST(ShouldRejectZeroRunsPastTheCounts)
+{
+    Histogram histogram{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    histogram.recordValue(1000L);
+
+    // Two runs of INT64_MAX zeros, which would wrap the index to -2, then a
+    // count of one; and a run of INT64_MIN, which cannot be negated.
+    std::vector< uint8_t > wrapping{ 0xfd, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                                     0xfd, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x02 };
+    std::vector< uint8_t > unnegatable{ 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x02 };
+    std::vector< uint8_t > valid{ 0x02 };
+
+    auto validBuffer = encodingWithPayload(histogram, valid);
+    auto decoded = Histogram::decodeFromCompressedByteBuffer(validBuffer.data(), validBuffer.size());
+    CHECK(nullptr != decoded);
+    CHECK_EQUAL(1, decoded->getCountAtValue(0));
+
+    for (auto& payload : { wrapping, unnegatable })
+    {
+        auto crafted = encodingWithPayload(histogram, payload);
+        CHECK(nullptr == Histogram::decodeFromCompressedByteBuffer(crafted.data(), crafted.size()));
+
+        Histogram sameLayout{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+        CHECK(!sameLayout.addEncoded(crafted.data(), crafted.size()));
+        CHECK_EQUAL(0, sameLayout.getTotalCount());
+    }
+}
+
+TEST(ShouldIterateRecordedAndAllValues)
+{
+    Histogram histogram{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    Histogram histogramCorrected{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    loadHistograms(histogram, histogramCorrected);
+
+    int steps = 0;
+    int64_t totalAdded = 0;
+    for (auto& value : histogram.recordedValues())
+    {
+        if (0 == steps)
+        {
+            CHECK_EQUAL(10000, value.getCountAtValueIteratedTo());
+            CHECK(histogram.valuesAreEquivalent(1000L, value.getValueIteratedTo()));
+        }
+        else
+        {
+            CHECK_EQUAL(1, value.getCountAtValueIteratedTo());
+            CHECK(histogram.valuesAreEquivalent(100000000L, value.getValueIteratedTo()));
+        }
+        totalAdded += value.getCountAddedInThisIterationStep();
+        steps++;
+    }
+    CHECK_EQUAL(2, steps);
+    CHECK_EQUAL(10001, totalAdded);
+
+    steps = 0;
+    totalAdded = 0;
+    int64_t visited = 0;
+    histogramCorrected.forAll([&] (int64_t, int64_t count)
+    {
+        visited += (0 != count) ? 1 : 0;
+    });
+    for (auto& value : histogramCorrected.allValues())
+    {
+        totalAdded += value.getCountAddedInThisIterationStep();
+        steps++;
+    }
+    CHECK_EQUAL(20000, totalAdded);
+    CHECK(steps > visited);
+    CHECK_EQUAL(histogramCorrected.getTotalCount(), totalAdded);
+}
+
+TEST(ShouldIterateLinearAndLogarithmicBuckets)
+{
+    Histogram histogram{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    Histogram histogramCorrected{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    loadHistograms(histogram, histogramCorrected);
+
+    int steps = 0;
+    for (auto& value : histogram.linearBucketValues(100000))
+    {
+        auto countAdded = value.getCountAddedInThisIterationStep();
+        if (0 == steps)
+        {
+            CHECK_EQUAL(10000, countAdded);
+        }
+        else if (999 == steps)
+        {
+            CHECK_EQUAL(1, countAdded);
+        }
+        else
+        {
+            CHECK_EQUAL(0, countAdded);
+        }
+        steps++;
+    }
+    CHECK_EQUAL(1000, steps);
+
+    steps = 0;
+    int64_t totalAdded = 0;
+    for (auto& value : histogramCorrected.linearBucketValues(10000))
+    {
+        if (0 == steps)
+        {
+            CHECK_EQUAL(10000, value.getCountAddedInThisIterationStep());
+        }
+        totalAdded += value.getCountAddedInThisIterationStep();
+        steps++;
+    }
+    CHECK_EQUAL(10000, steps);
+    CHECK_EQUAL(20000, totalAdded);
+
+    steps = 0;
+    for (auto& value : histogram.logarithmicBucketValues(10000, 2))
+    {
+        auto countAdded = value.getCountAddedInThisIterationStep();
+        CHECK_EQUAL((0 == steps) ? 10000 : (14 == steps) ? 1 : 0, countAdded);
+        steps++;
+    }
+    CHECK_EQUAL(15, steps);
+
+    totalAdded = 0;
+    for (auto& value : histogramCorrected.logarithmicBucketValues(10000, 2))
+    {
+        totalAdded += value.getCountAddedInThisIterationStep();
+    }
+    CHECK_EQUAL(20000, totalAdded);
+}
+
+TEST(ShouldIteratePercentiles)
+{
+    Histogram histogram{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    Histogram histogramCorrected{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    loadHistograms(histogram, histogramCorrected);
+
+    double lastPercentile = -1.0;
+    for (auto& value : histogramCorrected.percentiles(5))
+    {
+        CHECK(value.getPercentileLevelIteratedTo() > lastPercentile);
+        CHECK(histogramCorrected.valuesAreEquivalent(value.getValueIteratedTo(),
+                                                     histogramCorrected.getValueAtPercentile(value.getPercentile())));
+        lastPercentile = value.getPercentileLevelIteratedTo();
+    }
+    CHECK_EQUAL(100.0, lastPercentile);
+
+    int visits = 0;
+    histogram.forPercentiles(5, [&] (double percentileTo, int64_t value, int64_t count)
+    {
+        visits++;
+        CHECK(count > 0 && value > 0 && percentileTo >= 0.0);
+    });
+    CHECK(visits > 2);
+
+    Histogram empty{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    CHECK(empty.percentiles(5).begin() == empty.percentiles(5).end());
+    CHECK(empty.recordedValues().begin() == empty.recordedValues().end());
+}
+
+TEST(ShouldFindOccupiedBlocks)
+{
+    OccupancyBitmap occupancy;
+    occupancy.resize(10000);
+    CHECK_EQUAL(10000, occupancy.nextOccupied(0));
+    CHECK_EQUAL(-1, occupancy.previousOccupied(9999));
+
+    occupancy.mark(70);
+    occupancy.mark(4100);
+    occupancy.mark(9999);
+    CHECK_EQUAL(64, occupancy.nextOccupied(0));
+    CHECK_EQUAL(70, occupancy.nextOccupied(70));
+    CHECK_EQUAL(4096, occupancy.nextOccupied(128));
+    CHECK_EQUAL(9984, occupancy.nextOccupied(4160));
+    CHECK_EQUAL(128, occupancy.nextUnoccupied(64));
+    CHECK_EQUAL(10000, occupancy.nextUnoccupied(9990));
+    CHECK_EQUAL(9999, occupancy.previousOccupied(9999));
+    CHECK_EQUAL(4159, occupancy.previousOccupied(9983));
+    CHECK_EQUAL(127, occupancy.previousOccupied(4095));
+    CHECK_EQUAL(-1, occupancy.previousOccupied(63));
+
+    occupancy.clear();
+    CHECK_EQUAL(10000, occupancy.nextOccupied(0));
+}
+
+TEST(ShouldSkipEmptyBlocksWhenScanning)
+{
+    // Two modes far apart, with nothing recorded between them.
+    Histogram tracked{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    Histogram scanned{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    Histogram indexed{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    Histogram tail{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    scanned.setStatisticsTracking(false);
+    indexed.setRankIndexing(true);
+    for (int64_t value = 0; value < 5000; value += 7)
+    {
+        tracked.recordValue(value);
+        scanned.recordValue(value);
+        indexed.recordValue(value);
+    }
+    for (int64_t value = 500000000L; value < 600000000L; value += 99991)
+    {
+        tracked.recordValue(value);
+        scanned.recordValue(value);
+        indexed.recordValue(value);
+        tail.recordValue(value);
+    }
+
+    CHECK_EQUAL(tracked.getMaxValue(), scanned.getMaxValue());
+    CHECK_EQUAL(0, scanned.getMinValue());
+    CHECK_CLOSE(tracked.getMeanValue(), scanned.getMeanValue(), 0.001);
+
+    int64_t visitedCount = 0;
+    int64_t recordedCount = 0;
+    scanned.forAll([&] (int64_t value, int64_t count)
+    {
+        CHECK_EQUAL(count, tracked.getCountAtValue(value));
+        visitedCount += count;
+    });
+    for (auto& value : scanned.recordedValues())
+    {
+        CHECK(0 != value.getCountAtValueIteratedTo());
+        recordedCount += value.getCountAddedInThisIterationStep();
+    }
+    CHECK_EQUAL(tracked.getTotalCount(), visitedCount);
+    CHECK_EQUAL(tracked.getTotalCount(), recordedCount);
+
+    const double percentiles[] = { 0.0, 10.0, 50.0, 80.0, 99.0, 100.0 };
+    for (auto percentile : percentiles)
+    {
+        CHECK_EQUAL(indexed.getValueAtPercentile(percentile), scanned.getValueAtPercentile(percentile));
+    }
+    CHECK_CLOSE(indexed.getPercentileAtOrBelowValue(550000000L), scanned.getPercentileAtOrBelowValue(550000000L),
+                0.000001);
+    CHECK_EQUAL(indexed.getCountBetweenValues(1000L, 550000000L), scanned.getCountBetweenValues(1000L, 550000000L));
+
+    // Taking the tail away leaves its blocks marked but empty.
+    scanned.subtract(tail);
+    CHECK_EQUAL(0, scanned.getMinValue());
+    CHECK(scanned.valuesAreEquivalent(4998L, scanned.getMaxValue()));
+    CHECK_EQUAL(scanned.getMaxValue(), scanned.getValueAtPercentile(100.0));
+
+    Histogram merged{ HIGHEST_TRACKABLE_VALUE, SIGNIFICANT_DIGITS };
+    merged.add(tail);
+    merged.add(scanned);
+    CHECK_EQUAL(tracked.getTotalCount(), merged.getTotalCount());
+    CHECK_EQUAL(tracked.getMaxValue(), merged.getMaxValue());
+    CHECK_EQUAL(tracked.getValueAtPercentile(90.0), merged.getValueAtPercentile(90.0));
+
+    scanned.reset();
+    scanned.recordValue(3000L);
+    CHECK_EQUAL(3000L, scanned.getMinValue());
+    CHECK_EQUAL(3000L, scanned.getMaxValue());
+}
@@ -0,0 +1,324 @@
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <algorithm>
+#include <assert.h>
+#include <stdint.h>
+#include <math.h>
+#include <string.h>
+#include <stdio.h>
+#include <UnitTest++.h>
+#include <histogram.h>
+#include <base64.h>
+#include <histogram_log.h>
+#include <histogram_log_index.h>
+#include <histogram_log_processor.h>
+
+TEST(ShouldRoundTripBase64)
+{
+    const char* encoded[] = { "", "Zg==", "Zm8=", "Zm9v", "Zm9vYg==", "Zm9vYmE=", "Zm9vYmFy" };
+    for (size_t length = 0; length <= 6; length++)
+    {
+        char buffer[16];
+        auto encodedLength = base64Encode((const uint8_t*) "foobar", length, buffer);
+        CHECK_EQUAL(base64EncodedLength(length), encodedLength);
+        CHECK_EQUAL(std::string{ encoded[length] }, std::string(buffer, encodedLength));
+
+        uint8_t decoded[16];
+        size_t decodedLength;
+        CHECK(base64Decode(buffer, encodedLength, decoded, decodedLength));
+        CHECK_EQUAL(length, decodedLength);
+        CHECK(0 == memcmp("foobar", decoded, length));
+    }
+
+    uint8_t decoded[16];
+    size_t decodedLength;
+    CHECK(!base64Decode("Zm9", 3, decoded, decodedLength));
+    CHECK(!base64Decode("Zm!v", 4, decoded, decodedLength));
+}
+
+TEST(ShouldWriteAndReadIntervalLog)
+{
+    std::stringstream log;
+    HistogramLogWriter writer{ log };
+    writer.outputLogFormatVersion();
+    writer.outputComment("[Logged with HdrHistogramCpp]");
+    writer.outputStartTime(1441812279.474);
+    writer.setBaseTime(1441812279.474);
+    writer.outputBaseTime(writer.getBaseTime());
+    writer.outputLegend();
+
+    Histogram histogram{ 3600000000, 3 };
+    for (int interval = 0; interval < 5; interval++)
+    {
+        histogram.reset();
+        for (int64_t i = 1; i <= 1000; i++)
+        {
+            histogram.recordValue(i * 1000 * (interval + 1));
+        }
+        writer.outputIntervalHistogram(1441812279.474 + interval, 1441812280.474 + interval, histogram,
+                                       (interval % 2) ? "odd" : "");
+    }
+
+    std::string header;
+    std::getline(log, header);
+    CHECK_EQUAL("#[Histogram log format version 1.3]", header);
+    log.seekg(0);
+
+    HistogramLogReader reader{ log };
+    for (int interval = 0; interval < 5; interval++)
+    {
+        auto read = reader.nextIntervalHistogram();
+        CHECK(nullptr != read);
+        CHECK_EQUAL(1000, read->getTotalCount());
+        CHECK(read->valuesAreEquivalent(1000000 * (interval + 1), read->getMaxValue()));
+        CHECK_CLOSE(1441812279.474 + interval, reader.getIntervalStartTimeSec(), 0.0005);
+        CHECK_CLOSE(1441812280.474 + interval, reader.getIntervalEndTimeSec(), 0.0005);
+        CHECK_EQUAL((interval % 2) ? "odd" : "", reader.getIntervalTag());
+    }
+    CHECK(nullptr == reader.nextIntervalHistogram());
+    CHECK_CLOSE(1441812279.474, reader.getStartTimeSec(), 0.0005);
+}
+
+TEST(ShouldReadIntervalLogTimeRanges)
+{
+    // No base time line, so the small timestamps are taken as relative.
+    std::stringstream log;
+    HistogramLogWriter writer{ log };
+    writer.outputStartTime(1000000000.0);
+    writer.setBaseTime(1000000000.0);
+    writer.outputLegend();
+
+    Histogram histogram{ 3600000000, 3 };
+    for (int interval = 0; interval < 10; interval++)
+    {
+        histogram.recordValue(1000);
+        writer.outputIntervalHistogram(1000000000.0 + interval, 1000000001.0 + interval, histogram);
+    }
+    log << "not an interval line\n";
+
+    HistogramLogReader reader{ log };
+    auto read = reader.nextIntervalHistogram(1000000003.0, 1000000005.0);
+    CHECK(nullptr != read);
+    CHECK_EQUAL(4, read->getTotalCount());
+    CHECK_CLOSE(1000000000.0, reader.getBaseTimeSec(), 0.0005);
+    CHECK_EQUAL(5, reader.nextIntervalHistogram(1000000003.0, 1000000005.0)->getTotalCount());
+    CHECK_EQUAL(6, reader.nextIntervalHistogram(1000000003.0, 1000000005.0)->getTotalCount());
+    CHECK(nullptr == reader.nextIntervalHistogram(1000000003.0, 1000000005.0));
+    CHECK_EQUAL(8, reader.nextIntervalHistogram()->getTotalCount());
+}
+
+TEST(ShouldSkipMalformedIntervals)
+{
+    std::stringstream log;
+    HistogramLogWriter writer{ log };
+    writer.outputStartTime(1000000000.0);
+    writer.setBaseTime(1000000000.0);
+
+    Histogram histogram{ 3600000000, 3 };
+    histogram.recordValue(1000);
+    writer.outputIntervalHistogram(1000000000.0, 1000000001.0, histogram);
+
+    // Valid base64, but not a histogram encoding.
+    uint8_t garbage[48];
+    memset(garbage, 0x1c, sizeof(garbage));
+    std::vector< char > payload(base64EncodedLength(sizeof(garbage)));
+    base64Encode(garbage, sizeof(garbage), payload.data());
+    log << "1.000,1.000,1.000," << std::string(payload.data(), payload.size()) << "\n";
+
+    histogram.recordValue(2000);
+    writer.outputIntervalHistogram(1000000002.0, 1000000003.0, histogram);
+
+    HistogramLogReader reader{ log };
+    CHECK_EQUAL(1, reader.nextIntervalHistogram()->getTotalCount());
+    CHECK_EQUAL(0, reader.getSkippedIntervalCount());
+    CHECK_EQUAL(2, reader.nextIntervalHistogram()->getTotalCount());
+    CHECK_EQUAL(1, reader.getSkippedIntervalCount());
+    CHECK(nullptr == reader.nextIntervalHistogram());
+
+    // A last line without its newline may still be being written, so it is
+    // only read once it is complete.
+    std::stringstream growing;
+    HistogramLogWriter growingWriter{ growing };
+    growingWriter.setBaseTime(1000000000.0);
+    growingWriter.outputIntervalHistogram(1000000000.0, 1000000001.0, histogram);
+    std::string complete = growing.str();
+    growing.str(complete.substr(0, complete.size() - 1));
+    HistogramLogReader growingReader{ growing };
+    CHECK(nullptr == growingReader.nextIntervalHistogram());
+    growing.seekp(0, std::ios_base::end);
+    growing << "\n";
+    CHECK_EQUAL(2, growingReader.nextIntervalHistogram()->getTotalCount());
+}
+
+TEST(ShouldSeekIntervalLogWithIndex)
+{
+    std::stringstream log;
+    HistogramLogWriter writer{ log };
+    writer.outputLogFormatVersion();
+    writer.outputStartTime(1000000000.0);
+    writer.setBaseTime(1000000000.0);
+    writer.outputBaseTime(writer.getBaseTime());
+    writer.outputLegend();
+
+    Histogram histogram{ 3600000000, 3 };
+    auto logIntervals = [&] (int from, int to)
+    {
+        for (int interval = from; interval < to; interval++)
+        {
+            histogram.reset();
+            histogram.recordValueWithCount(1000, interval + 1);
+            writer.outputIntervalHistogram(1000000000.0 + interval, 1000000001.0 + interval, histogram);
+        }
+    };
+    logIntervals(0, 100);
+
+    HistogramLogIndex index{ 16 };
+    index.update(log);
+    CHECK_EQUAL(7u, index.getEntryCount());
+
+    // Part of a line still being written is not indexed until it is complete.
+    std::streampos completeLength = log.tellp();
+    log << "12.000,1.0";
+    index.update(log);
+    CHECK_EQUAL(7u, index.getEntryCount());
+    log.seekp(completeLength);
+    logIntervals(100, 200);
+    index.update(log);
+    CHECK_EQUAL(13u, index.getEntryCount());
+
+    std::stringstream saved;
+    index.save(saved);
+    HistogramLogIndex loaded;
+    CHECK(loaded.load(saved));
+    CHECK_EQUAL(16, loaded.getStrideIntervals());
+    CHECK_EQUAL(13u, loaded.getEntryCount());
+    logIntervals(200, 250);
+    loaded.update(log);
+    CHECK_EQUAL(16u, loaded.getEntryCount());
+
+    for (int first : { 0, 1, 16, 17, 150, 231 })
+    {
+        HistogramLogReader reader{ log };
+        loaded.seek(reader, 1000000000.0 + first);
+        auto read = reader.nextIntervalHistogram(1000000000.0 + first, 1000000000.0 + first + 2);
+        CHECK(nullptr != read);
+        CHECK_EQUAL(first + 1, read->getTotalCount());
+        CHECK_EQUAL(first + 2, reader.nextIntervalHistogram(1000000000.0 + first, 1000000000.0 + first + 2)->getTotalCount());
+    }
+
+    std::stringstream notAnIndex{ "#[Histogram log format version 1.3]\n" };
+    CHECK(!loaded.load(notAnIndex));
+    CHECK_EQUAL(0u, loaded.getEntryCount());
+}
+
+TEST(ShouldProcessIntervalLogInParallel)
+{
+    const std::string logPath = "test_histogram_log_processor.hlog";
+    Histogram expected{ 3600000000, 3 };
+    std::vector< Histogram > expectedWindows;
+    uint8_t garbage[48];
+    memset(garbage, 0x1c, sizeof(garbage));
+    std::vector< char > payload(base64EncodedLength(sizeof(garbage)));
+    base64Encode(garbage, sizeof(garbage), payload.data());
+
+    // An interval cut off halfway through its compressed counts, with the
+    // length in its header shortened to match.
+    Histogram truncatedHistogram{ 3600000000, 3 };
+    for (int64_t i = 1; i <= 20000; i++)
+    {
+        truncatedHistogram.recordValue(i * 97);
+    }
+    std::vector< uint8_t > truncatedBuffer(truncatedHistogram.getNeededByteBufferCapacity());
+    auto truncatedLength = truncatedHistogram.encodeIntoCompressedByteBuffer(truncatedBuffer.data(), truncatedBuffer.size());
+    truncatedLength /= 2;
+    for (int i = 0; i < 4; i++)
+    {
+        truncatedBuffer[4 + i] = (uint8_t) ((truncatedLength - 8) >> (24 - 8 * i));
+    }
+    std::vector< char > truncatedPayload(base64EncodedLength(truncatedLength));
+    base64Encode(truncatedBuffer.data(), truncatedLength, truncatedPayload.data());
+    {
+        std::ofstream log{ logPath };
+        HistogramLogWriter writer{ log };
+        writer.outputLogFormatVersion();
+        writer.outputStartTime(1000000000.0);
+        writer.setBaseTime(1000000000.0);
+        writer.outputLegend();
+
+        Histogram histogram{ 3600000000, 3 };
+        for (int interval = 0; interval < 300; interval++)
+        {
+            histogram.reset();
+            for (int64_t i = 1; i <= 50; i++)
+            {
+                histogram.recordValue(i * 1000 + interval * 7919 % 100000);
+            }
+            writer.outputIntervalHistogram(1000000000.0 + interval, 1000000001.0 + interval, histogram);
+            writer.outputIntervalHistogram(1000000000.0 + interval, 1000000001.0 + interval, histogram, "other");
+            if (0 == interval % 50)
+            {
+                log << interval << ".000,1.000,1.000," << std::string(payload.data(), payload.size()) << "\n";
+            }
+            if (25 == interval % 50)
+            {
+                log << interval << ".000,1.000,1.000," << std::string(truncatedPayload.data(), truncatedPayload.size()) << "\n";
+            }
+
+            expected.add(histogram);
+            if (0 == interval % 7)
+            {
+                expectedWindows.emplace_back(3600000000, 3);
+            }
+            expectedWindows.back().add(histogram);
+        }
+    }
+
+    std::ifstream indexedLog{ logPath };
+    HistogramLogIndex index{ 10 };
+    index.update(indexedLog);
+
+    for (unsigned threads : { 1u, 3u, 8u })
+    {
+        for (bool indexed : { false, true })
+        {
+            HistogramLogProcessor processor{ 1, 3600000000, 3 };
+            processor.setThreads(threads);
+            processor.setWindowLength(7.0);
+            processor.setIndex(indexed ? &index : nullptr);
+            CHECK(processor.process(logPath));
+            CHECK_EQUAL(12, processor.getFailedIntervalCount());
+
+            auto& merged = processor.getHistogram();
+            CHECK_EQUAL(expected.getTotalCount(), merged.getTotalCount());
+            CHECK_EQUAL(expected.getMaxValue(), merged.getMaxValue());
+            CHECK_EQUAL(expected.getValueAtPercentile(99.0), merged.getValueAtPercentile(99.0));
+
+            auto& windows = processor.getWindows();
+            CHECK_EQUAL(expectedWindows.size(), windows.size());
+            for (size_t i = 0; i < std::min(windows.size(), expectedWindows.size()); i++)
+            {
+                CHECK_CLOSE(1000000000.0 + 7 * i, windows[i].startTimeSec, 0.0005);
+                CHECK_EQUAL(expectedWindows[i].getTotalCount(), windows[i].summary.totalCount);
+                CHECK_EQUAL(expectedWindows[i].getValueAtPercentile(50.0), windows[i].percentileValues[0]);
+                CHECK_EQUAL(expectedWindows[i].getMaxValue(), windows[i].summary.maxValue);
+            }
+        }
+    }
+
+    HistogramLogProcessor tagged{ 1, 3600000000, 3 };
+    tagged.setTag("other");
+    CHECK(tagged.process(logPath));
+    CHECK_EQUAL(expected.getTotalCount(), tagged.getHistogram().getTotalCount());
+    CHECK(tagged.getWindows().empty());
+    CHECK_EQUAL(0, tagged.getFailedIntervalCount());
+
+    CHECK(!tagged.process(logPath + ".missing"));
+    remove(logPath.c_str());
+}
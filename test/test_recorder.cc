@@ -0,0 +1,83 @@
+#include <iostream>
+#include <vector>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <thread>
+#include <iterator>
+#include <limits>
+#include <algorithm>
+#include <assert.h>
+#include <stdint.h>
+#include <math.h>
+#include <UnitTest++.h>
+#include <histogram.h>
+#include <atomic_histogram.h>
+#include <writer_reader_phaser.h>
+#include <recorder.h>
+
+TEST(RecorderShouldReturnValuesRecordedSinceLastInterval)
+{
+    Recorder recorder{ 3600000000, 3 };
+
+    recorder.recordValue(1000L);
+    recorder.recordValue(2000L);
+
+    const AtomicHistogram& first = recorder.getIntervalHistogram();
+    CHECK_EQUAL(2, first.getTotalCount());
+    CHECK_EQUAL(1, first.getCountAtValue(1000L));
+
+    recorder.recordValue(3000L);
+
+    const AtomicHistogram& second = recorder.getIntervalHistogram();
+    CHECK_EQUAL(1, second.getTotalCount());
+    CHECK_EQUAL(0, second.getCountAtValue(1000L));
+    CHECK_EQUAL(1, second.getCountAtValue(3000L));
+
+    const AtomicHistogram& empty = recorder.getIntervalHistogram();
+    CHECK_EQUAL(0, empty.getTotalCount());
+}
+
+TEST(RecorderShouldReset)
+{
+    Recorder recorder{ 3600000000, 3 };
+
+    recorder.recordValue(1000L);
+    recorder.reset();
+
+    CHECK_EQUAL(0, recorder.getIntervalHistogram().getTotalCount());
+    CHECK_EQUAL(0, recorder.getIntervalHistogram().getTotalCount());
+}
+
+TEST(RecorderShouldNotLoseValuesAcrossIntervals)
+{
+    const int threadCount = 4;
+    const int valuesPerThread = 200000;
+    Recorder recorder{ 3600000000, 3 };
+
+    std::vector< std::thread > threads;
+    for (int t = 0; t < threadCount; t++)
+    {
+        threads.emplace_back([&recorder] ()
+        {
+            for (int i = 0; i < valuesPerThread; i++)
+            {
+                recorder.recordValue(1000L);
+            }
+        });
+    }
+
+    int64_t total = 0;
+    for (int i = 0; i < 100; i++)
+    {
+        total += recorder.getIntervalHistogram().getTotalCount();
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    total += recorder.getIntervalHistogram().getTotalCount();
+
+    CHECK_EQUAL(threadCount * valuesPerThread, total);
+}
@@ -0,0 +1,67 @@
+#include <iostream>
+#include <vector>
+#include <array>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <algorithm>
+#include <memory>
+#include <x86intrin.h>
+#include <math.h>
+#include <assert.h>
+#include <UnitTest++.h>
+#include <histogram.h>
+#include <static_histogram.h>
+
+typedef StaticHistogram< 3600000000, 3 > HourHistogram;
+
+TEST(StaticShouldComputeLayoutAtCompileTime)
+{
+    static_assert(HourHistogram::subBucketCount == 2048, "sub bucket count");
+    static_assert(HourHistogram::bucketCount == 22, "bucket count");
+    static_assert(HourHistogram::countsArrayLength == 23 * 1024, "counts length");
+
+    CHECK_EQUAL(3600000000, HourHistogram().getHighestTrackableValue());
+    CHECK_EQUAL(3, HourHistogram().getNumberOfSignificantValueDigits());
+}
+
+TEST(StaticShouldMatchHistogram)
+{
+    std::unique_ptr< HourHistogram > fixed{ new HourHistogram };
+    Histogram histogram{ 3600000000, 3 };
+
+    for (int i = 0; i < 10000; i++)
+    {
+        fixed->recordValue(1000L, 10000L);
+        histogram.recordValue(1000L, 10000L);
+    }
+    fixed->recordValue(100000000L, 10000L);
+    histogram.recordValue(100000000L, 10000L);
+
+    CHECK_EQUAL(histogram.getTotalCount(), fixed->getTotalCount());
+    CHECK_EQUAL(histogram.getCountAtValue(1000L), fixed->getCountAtValue(1000L));
+    CHECK_EQUAL(histogram.getMaxValue(), fixed->getMaxValue());
+    CHECK_EQUAL(histogram.getMinValue(), fixed->getMinValue());
+    CHECK_CLOSE(histogram.getMeanValue(), fixed->getMeanValue(), 0.001);
+    CHECK_EQUAL(histogram.getValueAtPercentile(50.0), fixed->getValueAtPercentile(50.0));
+    CHECK_EQUAL(histogram.getValueAtPercentile(99.0), fixed->getValueAtPercentile(99.0));
+    CHECK(fixed->valuesAreEquivalent(100000000L, fixed->getMaxValue()));
+
+    // One value per unit below an hour: sub-buckets, not values, set the cost.
+    fixed->reset();
+    histogram.reset();
+    fixed->recordValue(3600000000L, 1);
+    histogram.recordValue(3600000000L, 1);
+    CHECK_EQUAL(3600000000L, fixed->getTotalCount());
+    int64_t mismatches = 0;
+    fixed->forAll([&] (int64_t value, int64_t count)
+    {
+        mismatches += (histogram.getCountAtValue(value) != count) ? 1 : 0;
+    });
+    CHECK_EQUAL(0, mismatches);
+    CHECK_EQUAL(histogram.getValueAtPercentile(50.0), fixed->getValueAtPercentile(50.0));
+
+    fixed->reset();
+    CHECK_EQUAL(0, fixed->getTotalCount());
+    CHECK_EQUAL(0, fixed->getCountAtValue(1000L));
+}
@@ -0,0 +1,144 @@
+#include <iostream>
+#include <vector>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <thread>
+#include <iterator>
+#include <limits>
+#include <algorithm>
+#include <assert.h>
+#include <stdint.h>
+#include <math.h>
+#include <UnitTest++.h>
+#include <histogram.h>
+#include <atomic_histogram.h>
+#include <striped_histogram.h>
+
+TEST(StripedShouldKeepOneShardPerThread)
+{
+    const int threadCount = 4;
+    StripedHistogram striped{ 3600000000, 3 };
+
+    striped.recordValue(1000L);
+    striped.recordValue(1000L);
+    CHECK_EQUAL(1U, striped.getShardCount());
+
+    std::vector< std::thread > threads;
+    for (int t = 0; t < threadCount; t++)
+    {
+        threads.emplace_back([&striped] ()
+        {
+            striped.recordValue(1000L);
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    CHECK_EQUAL((size_t) threadCount + 1, striped.getShardCount());
+}
+
+TEST(StripedShouldMergeShardsOnSnapshot)
+{
+    const int threadCount = 8;
+    const int valuesPerThread = 100000;
+    StripedHistogram striped{ 3600000000, 3 };
+
+    std::vector< std::thread > threads;
+    for (int t = 0; t < threadCount; t++)
+    {
+        threads.emplace_back([&striped, t] ()
+        {
+            for (int i = 0; i < valuesPerThread; i++)
+            {
+                striped.recordValue(1000L * (t + 1));
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    AtomicHistogram merged{ 3600000000, 3 };
+    striped.snapshot(merged);
+
+    CHECK_EQUAL(threadCount * valuesPerThread, merged.getTotalCount());
+    for (int t = 0; t < threadCount; t++)
+    {
+        CHECK_EQUAL(valuesPerThread, merged.getCountAtValue(1000L * (t + 1)));
+    }
+    CHECK(merged.valuesAreEquivalent(8000L, merged.getMaxValue()));
+
+    striped.reset();
+    striped.snapshot(merged);
+    CHECK_EQUAL(0, merged.getTotalCount());
+
+    striped.recordValue(2000L);
+    striped.snapshot(merged);
+    CHECK_EQUAL(1, merged.getTotalCount());
+    CHECK_EQUAL(1, merged.getCountAtValue(2000L));
+}
+
+TEST(StripedShouldResetAndSnapshotWhileRecording)
+{
+    const int threadCount = 4;
+    StripedHistogram striped{ 3600000000, 3 };
+    AtomicHistogram merged{ 3600000000, 3 };
+
+    std::atomic< bool > recording{ true };
+    std::vector< std::thread > threads;
+    for (int t = 0; t < threadCount; t++)
+    {
+        threads.emplace_back([&striped, &recording, t] ()
+        {
+            for (int64_t i = 0; recording.load(); i++)
+            {
+                striped.recordValue(1000L * (t + 1) + i % 1000);
+            }
+        });
+    }
+
+    // However the resets and snapshots interleave with the writers, every
+    // snapshot's total is the sum of its counts.
+    for (int i = 0; i < 200; i++)
+    {
+        striped.reset();
+        striped.snapshot(merged);
+        int64_t counted = 0;
+        for (auto& value : merged.allValues())
+        {
+            counted += value.getCountAtValueIteratedTo();
+        }
+        CHECK_EQUAL(merged.getTotalCount(), counted);
+    }
+
+    recording.store(false);
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    // Once the writers are done, a reset leaves nothing behind.
+    striped.reset();
+    striped.snapshot(merged);
+    CHECK_EQUAL(0, merged.getTotalCount());
+}
+
+TEST(StripedShouldNotShareShardsBetweenInstances)
+{
+    StripedHistogram first{ 3600000000, 3 };
+    StripedHistogram second{ 3600000000, 3 };
+
+    first.recordValue(1000L);
+    second.recordValue(2000L);
+    first.recordValue(1000L);
+
+    AtomicHistogram merged{ 3600000000, 3 };
+    first.snapshot(merged);
+    CHECK_EQUAL(2, merged.getCountAtValue(1000L));
+    CHECK_EQUAL(0, merged.getCountAtValue(2000L));
+}
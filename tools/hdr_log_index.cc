@@ -0,0 +1,87 @@
+#include <stdint.h>
+#include <math.h>
+#include <stdio.h>
+#include <assert.h>
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <limits>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
+#include "histogram.h"
+#include "histogram_log.h"
+#include "histogram_log_index.h"
+
+// Builds, or brings up to date, the sidecar index of a .hlog file.
+//
+//     hdr-log-index [-stride intervals] log.hlog [index]
+//
+// The index defaults to log.hlog.idx.  An existing index is extended with the
+// intervals logged since it was last updated.
+int main(int argc, char** argv)
+{
+    int32_t strideIntervals = 64;
+    std::vector< std::string > paths;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg{ argv[i] };
+        if ("-stride" == arg && i + 1 < argc)
+        {
+            strideIntervals = atoi(argv[++i]);
+        }
+        else
+        {
+            paths.push_back(arg);
+        }
+    }
+    if (paths.empty() || paths.size() > 2 || strideIntervals <= 0)
+    {
+        std::cerr << "usage: hdr-log-index [-stride intervals] log.hlog [index]" << std::endl;
+        return 2;
+    }
+
+    auto logPath   = paths[0];
+    auto indexPath = (paths.size() > 1) ? paths[1] : logPath + ".idx";
+
+    std::ifstream log{ logPath, std::ios::binary };
+    if (!log)
+    {
+        std::cerr << "cannot open " << logPath << std::endl;
+        return 1;
+    }
+
+    HistogramLogIndex index{ strideIntervals };
+    std::ifstream existing{ indexPath };
+    if (existing && !index.load(existing))
+    {
+        std::cerr << "ignoring unreadable index " << indexPath << std::endl;
+    }
+
+    auto entriesBefore = index.getEntryCount();
+    index.update(log);
+
+    auto temporaryPath = indexPath + ".tmp";
+    {
+        std::ofstream out{ temporaryPath };
+        index.save(out);
+        if (!out)
+        {
+            std::cerr << "cannot write " << temporaryPath << std::endl;
+            return 1;
+        }
+    }
+    if (0 != rename(temporaryPath.c_str(), indexPath.c_str()))
+    {
+        std::cerr << "cannot replace " << indexPath << std::endl;
+        return 1;
+    }
+
+    std::cout << indexPath << ": " << index.getEntryCount() << " entries ("
+              << (index.getEntryCount() - entriesBefore) << " new)" << std::endl;
+    return 0;
+}
@@ -0,0 +1,169 @@
+#include <stdint.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <limits>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
+#include "histogram.h"
+#include "histogram_log.h"
+#include "histogram_log_index.h"
+#include "histogram_log_processor.h"
+
+// Merges the intervals of a .hlog file on all cores, printing a percentile
+// series per window followed by the percentile distribution of the whole log.
+//
+//     hdr-log-process [-threads n] [-window sec] [-tag tag] [-index file]
+//                     [-percentiles 50,90,99] [-outputValueUnitRatio ratio]
+//                     [-highestTrackableValue value] [-significantDigits digits] log.hlog
+static void usage()
+{
+    std::cerr << "usage: hdr-log-process [-threads n] [-window sec] [-tag tag] [-index file]" << std::endl
+              << "                       [-percentiles 50,90,99] [-outputValueUnitRatio ratio]" << std::endl
+              << "                       [-highestTrackableValue value] [-significantDigits digits] log.hlog" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned threads = 0;
+    double windowLengthSec = 0.0;
+    std::string tag;
+    std::string indexPath;
+    std::vector< double > percentiles;
+    double outputValueUnitRatio = 1000000.0;
+    int64_t highestTrackableValue = 3600LL * 1000 * 1000 * 1000;
+    int64_t significantDigits = 3;
+    std::string logPath;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg{ argv[i] };
+        bool hasValue = i + 1 < argc;
+        if ("-threads" == arg && hasValue)
+        {
+            threads = (unsigned) atoi(argv[++i]);
+        }
+        else if ("-window" == arg && hasValue)
+        {
+            windowLengthSec = atof(argv[++i]);
+        }
+        else if ("-tag" == arg && hasValue)
+        {
+            tag = argv[++i];
+        }
+        else if ("-index" == arg && hasValue)
+        {
+            indexPath = argv[++i];
+        }
+        else if ("-percentiles" == arg && hasValue)
+        {
+            std::stringstream list{ argv[++i] };
+            std::string percentile;
+            while (std::getline(list, percentile, ','))
+            {
+                percentiles.push_back(atof(percentile.c_str()));
+            }
+        }
+        else if ("-outputValueUnitRatio" == arg && hasValue)
+        {
+            outputValueUnitRatio = atof(argv[++i]);
+        }
+        else if ("-highestTrackableValue" == arg && hasValue)
+        {
+            highestTrackableValue = atoll(argv[++i]);
+        }
+        else if ("-significantDigits" == arg && hasValue)
+        {
+            significantDigits = atoi(argv[++i]);
+        }
+        else if (logPath.empty() && '-' != arg[0])
+        {
+            logPath = arg;
+        }
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+    if (logPath.empty())
+    {
+        usage();
+        return 2;
+    }
+
+    HistogramLogProcessor processor{ 1, highestTrackableValue, significantDigits };
+    if (0 != threads)
+    {
+        processor.setThreads(threads);
+    }
+    processor.setWindowLength(windowLengthSec);
+    processor.setTag(tag);
+    if (!percentiles.empty())
+    {
+        std::sort(percentiles.begin(), percentiles.end());
+        processor.setPercentiles(percentiles);
+    }
+
+    HistogramLogIndex index;
+    if (!indexPath.empty())
+    {
+        std::ifstream in{ indexPath };
+        if (!in || !index.load(in))
+        {
+            std::cerr << "cannot read index " << indexPath << std::endl;
+            return 1;
+        }
+        processor.setIndex(&index);
+    }
+
+    if (!processor.process(logPath))
+    {
+        std::cerr << "cannot open " << logPath << std::endl;
+        return 1;
+    }
+    if (0 != processor.getFailedIntervalCount())
+    {
+        std::cerr << "skipped " << processor.getFailedIntervalCount() << " intervals that did not decode" << std::endl;
+    }
+
+    if (!processor.getWindows().empty())
+    {
+        std::cout << "\"StartTime\",\"EndTime\",\"Count\",\"Mean\",\"Max\"";
+        for (auto percentile : processor.getPercentiles())
+        {
+            std::cout << ",\"P" << percentile << "\"";
+        }
+        std::cout << "\n";
+
+        char column[64];
+        for (auto& window : processor.getWindows())
+        {
+            snprintf(column, sizeof(column), "%.3f,%.3f,%lld,%.3f,%.3f", window.startTimeSec, window.endTimeSec,
+                     (long long) window.summary.totalCount, window.summary.meanValue / outputValueUnitRatio,
+                     window.summary.maxValue / outputValueUnitRatio);
+            std::cout << column;
+            for (auto value : window.percentileValues)
+            {
+                snprintf(column, sizeof(column), ",%.3f", value / outputValueUnitRatio);
+                std::cout << column;
+            }
+            std::cout << "\n";
+        }
+        std::cout << "\n";
+    }
+
+    Histogram total{ processor.getHistogram() };
+    total.outputPercentileValues(std::cout, 5, outputValueUnitRatio);
+    return 0;
+}